@@ -1,3469 +1,4607 @@
 #include <QDebug>
 #include <QTimer>
 #include <QCoreApplication>
-#include "qredis.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <QSemaphore>
+#include <QCryptographicHash>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QIODevice>
+#include <string.h>
+#include <limits>
+#include "qrediscommands.h"
+
+redis_reply::redis_reply() : index_(0)
+{
+
+}
+
+redis_reply::redis_reply(redis_arena *arena, int index) : arena_(arena), index_(index)
+{
+
+}
 
-redis_reply::redis_reply(QObject *parent) : QObject(parent), reply_type_(REDIS_RESULT_NIL)
+const redis_node *redis_reply::node() const
 {
+	if (!arena_) return 0;
+	return &arena_->nodes.at(index_);
+}
 
+QString redis_reply::text() const
+{
+	const redis_node *n = node();
+	return QString::fromUtf8(arena_->bytes.constData() + n->str.offset, n->str.length);
 }
 
-redis_reply_t redis_reply::type()
+redis_reply_t redis_reply::type() const
 {
-	return reply_type_;
+	const redis_node *n = node();
+	return n ? n->type : REDIS_RESULT_UNKOWN;
 }
 
-qlonglong redis_reply::integer()
+qlonglong redis_reply::integer() const
 {
-	if (reply_type_ != REDIS_RESULT_INTEGER)
+	if (type() != REDIS_RESULT_INTEGER)
 		return -1;
-	return str.toLongLong();
+	return node()->integer;
 }
 
-QString redis_reply::status()
+QString redis_reply::status() const
 {
-	if (reply_type_ != REDIS_RESULT_STATUS)
+	if (type() != REDIS_RESULT_STATUS)
 		return "";
-	return str;
+	return text();
 }
 
-QString redis_reply::error()
+QString redis_reply::error() const
 {
-	if (reply_type_ != REDIS_RESULT_ERROR)
+	if (type() != REDIS_RESULT_ERROR)
 		return "";
-	return str;
+	return text();
 }
 
-QString redis_reply::string()
+QString redis_reply::string() const
 {
-	if (reply_type_ != REDIS_RESULT_STRING)
+	if (type() != REDIS_RESULT_STRING)
 		return "";
-	return str;
+	return text();
 }
 
-void redis_reply::setData(const QString &data)
+QByteArray redis_reply::bytes() const
 {
-	str = data;
+	if (type() != REDIS_RESULT_STRING)
+		return QByteArray();
+	const redis_node *n = node();
+	return QByteArray(arena_->bytes.constData() + n->str.offset, n->str.length);
 }
 
-void redis_reply::setType(redis_reply_t type)
+static bool is_aggregate(redis_reply_t type)
 {
-	reply_type_ = type;
+	return type == REDIS_RESULT_ARRAY || type == REDIS_RESULT_MAP || type == REDIS_RESULT_SET || type == REDIS_RESULT_PUSH;
 }
 
-QRedis::QRedis(QObject * parent) : QObject(parent)
+qreal redis_reply::real() const
 {
-	m_isconnected = false;
+	if (type() != REDIS_RESULT_DOUBLE)
+		return 0.0;
+	return node()->real;
+}
 
-	m_sock = new QTcpSocket(this);
-	connect(m_sock, SIGNAL(connected()), this, SLOT(connected()));
-	connect(m_sock, SIGNAL(disconnected()), this, SLOT(disconnected()));
-	connect(m_sock, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(error(QAbstractSocket::SocketError)));
+bool redis_reply::boolean() const
+{
+	if (type() != REDIS_RESULT_BOOLEAN)
+		return false;
+	return node()->integer != 0;
+}
 
-	m_subssock = new QTcpSocket(this);
-	connect(m_subssock, SIGNAL(readyRead()), this, SLOT(readyRead()));
-	connect(m_subssock, SIGNAL(connected()), this, SLOT(connected()));
-	connect(m_subssock, SIGNAL(disconnected()), this, SLOT(disconnected()));
-	connect(m_subssock, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(error(QAbstractSocket::SocketError)));
+QString redis_reply::bignumber() const
+{
+	if (type() != REDIS_RESULT_BIGNUMBER)
+		return "";
+	return text();
+}
 
-	QTimer *timer = new QTimer(this);
-	connect(timer, SIGNAL(timeout()), this, SLOT(check()));
-	timer->start(5000);
+bool redis_reply::isAggregate() const
+{
+	return is_aggregate(type());
 }
 
-QRedis::~QRedis()
+int redis_reply::count() const
 {
+	if (!is_aggregate(type()))
+		return 0;
+	return node()->count;
 }
 
-void QRedis::connectHost(const QString & hostName, quint16 port)
+redis_reply redis_reply::at(int i) const
 {
-	m_ip = hostName;
-	m_port = port;
-	m_sock->connectToHost(hostName, port);
-	if (!m_sock->waitForConnected(1000))
+	if (i < 0 || i >= count())
+		return redis_reply();
+	return redis_reply(arena_.data(), node()->first + i);
+}
+
+redis_reply redis_reply::fromError(const QString &message)
+{
+	redis_arena *arena = new redis_arena;
+	arena->bytes = message.toUtf8();
+	arena->nodes.resize(1);
+
+	redis_node &n = arena->nodes[0];
+	n.type = REDIS_RESULT_ERROR;
+	n.str.offset = 0;
+	n.str.length = arena->bytes.size();
+
+	return redis_reply(arena, 0);
+}
+
+static qlonglong parse_integer(const char *p, const char *end)
+{
+	bool negative = false;
+	if (p < end && *p == '-')
 	{
-		m_sock->disconnectFromHost();
-		return;
+		negative = true;
+		p++;
 	}
 
-	m_subssock->connectToHost(hostName, port);
-	if (!m_subssock->waitForConnected(1000))
+	qlonglong value = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++)
 	{
-		m_subssock->disconnectFromHost();
-		return;
+		value = value * 10 + (*p - '0');
 	}
+
+	return negative ? -value : value;
 }
 
-int QRedis::del(const QString &key)
+static double parse_double(const char *p, const char *end)
 {
-	QList<QByteArray>temp;
-	temp.append("del");
-	temp.append(key.toUtf8());
+	QByteArray text(p, end - p);
+	if (text == "inf") return std::numeric_limits<double>::infinity();
+	if (text == "-inf") return -std::numeric_limits<double>::infinity();
+	if (text == "nan") return std::numeric_limits<double>::quiet_NaN();
+	return text.toDouble();
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+static QString from_utf8(const QByteArray &data)
+{
+	return QString::fromUtf8(data.constData(), data.size());
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+static QStringList from_utf8(const QList<QByteArray> &list)
+{
+	QStringList result;
+	result.reserve(list.count());
+	foreach(const QByteArray &data, list)
 	{
-		m_error = "read time out";
-		return 0;
+		result << QString::fromUtf8(data.constData(), data.size());
 	}
+	return result;
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+static QList<QByteArray> to_utf8(const QStringList &list)
+{
+	QList<QByteArray> result;
+	result.reserve(list.count());
+	foreach(const QString &str, list)
 	{
-		m_error = rr->error();
+		result << str.toUtf8();
 	}
+	return result;
+}
 
-	return 0;
+bool redis_decoder<redis_reply>::decode(const redis_reply &rr, redis_reply &value)
+{
+	value = rr;
+	return true;
 }
 
-int QRedis::del(const QStringList &keys)
+bool redis_decoder<bool>::decode(const redis_reply &rr, bool &value)
 {
-	QList<QByteArray>temp;
-	temp.append("del");
-	foreach(QString key, keys)
+	switch (rr.type())
 	{
-		temp.append(key.toUtf8());
+	case REDIS_RESULT_NIL:
+		value = false;
+		return true;
+	case REDIS_RESULT_INTEGER:
+		value = rr.integer() != 0;
+		return true;
+	case REDIS_RESULT_BOOLEAN:
+		value = rr.boolean();
+		return true;
+	case REDIS_RESULT_STATUS:
+		value = true;
+		return true;
+	default:
+		return false;
 	}
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+bool redis_decoder<qlonglong>::decode(const redis_reply &rr, qlonglong &value)
+{
+	bool ok = true;
+	switch (rr.type())
 	{
-		m_error = "read time out";
-		return 0;
-	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-	if (rr->type() == REDIS_RESULT_INTEGER)
+	case REDIS_RESULT_NIL:
+		value = 0;
+		return true;
+	case REDIS_RESULT_INTEGER:
+		value = rr.integer();
+		return true;
+	case REDIS_RESULT_BOOLEAN:
+		value = rr.boolean() ? 1 : 0;
+		return true;
+	case REDIS_RESULT_STRING:
+	case REDIS_RESULT_STATUS:
+	case REDIS_RESULT_BIGNUMBER:
 	{
-		return rr->integer();
+		// scripts often hand numbers back as strings
+		QByteArray text;
+		redis_decode(rr, text);
+		value = text.toLongLong(&ok);
+		return ok;
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
+	default:
+		return false;
 	}
-
-	return 0;
 }
 
-bool QRedis::exists(const QString &key)
+bool redis_decoder<int>::decode(const redis_reply &rr, int &value)
 {
-	QList<QByteArray>temp;
-	temp.append("exists");
-	temp.append(key.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	qlonglong wide;
+	if (!redis_decode(rr, wide) || wide < std::numeric_limits<int>::min() || wide > std::numeric_limits<int>::max()) return false;
+	value = int(wide);
+	return true;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+bool redis_decoder<double>::decode(const redis_reply &rr, double &value)
+{
+	bool ok = true;
+	switch (rr.type())
+	{
+	case REDIS_RESULT_NIL:
+		value = 0.0;
+		return true;
+	case REDIS_RESULT_DOUBLE:
+		value = rr.real();
+		return true;
+	case REDIS_RESULT_INTEGER:
+		value = rr.integer();
+		return true;
+	case REDIS_RESULT_STRING:
+	case REDIS_RESULT_STATUS:
 	{
-		m_error = "read time out";
+		QByteArray text;
+		redis_decode(rr, text);
+		value = text.toDouble(&ok);
+		return ok;
+	}
+	default:
 		return false;
 	}
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+bool redis_decoder<QByteArray>::decode(const redis_reply &rr, QByteArray &value)
+{
+	switch (rr.type())
 	{
-		m_error = rr->error();
+	case REDIS_RESULT_NIL:
+		value = QByteArray();
+		return true;
+	case REDIS_RESULT_STRING:
+		value = rr.bytes();
+		return true;
+	case REDIS_RESULT_STATUS:
+		value = rr.status().toUtf8();
+		return true;
+	case REDIS_RESULT_BIGNUMBER:
+		value = rr.bignumber().toUtf8();
+		return true;
+	case REDIS_RESULT_INTEGER:
+		value = QByteArray::number(rr.integer());
+		return true;
+	case REDIS_RESULT_DOUBLE:
+		value = QByteArray::number(rr.real(), 'g', 17);
+		return true;
+	default:
+		return false;
 	}
-
-	return false;
 }
 
-bool QRedis::expire(const QString &key, qlonglong secs)
+bool redis_decoder<QString>::decode(const redis_reply &rr, QString &value)
 {
-	QList<QByteArray>temp;
-	temp.append("expire");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(secs).toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	QByteArray data;
+	if (!redis_decode(rr, data)) return false;
+	value = data.isNull() ? QString() : from_utf8(data);
+	return true;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+static int integer_width(qulonglong value)
+{
+	int width = 1;
+	while (value >= 10)
 	{
-		m_error = "read time out";
-		return false;
+		value /= 10;
+		width++;
 	}
+	return width;
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-	if (rr->type() == REDIS_RESULT_INTEGER)
+static char *write_integer(char *p, qlonglong value)
+{
+	qulonglong u = value;
+	if (value < 0)
 	{
-		return rr->integer();
+		*p++ = '-';
+		u = 0 - u;
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+
+	char *end = p + integer_width(u);
+	char *q = end;
+	do
 	{
-		m_error = rr->error();
-	}
+		*--q = '0' + (u % 10);
+		u /= 10;
+	} while (u);
 
-	return false;
+	return end;
 }
 
-bool QRedis::expireat(const QString &key, qlonglong timestamp)
+static char *write_header(char *p, char prefix, int value)
 {
-	QList<QByteArray>temp;
-	temp.append("expireat");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(timestamp).toUtf8());
+	*p++ = prefix;
+	p = write_integer(p, value);
+	*p++ = '\r';
+	*p++ = '\n';
+	return p;
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+static char *write_bulk(char *p, const char *data, int len)
+{
+	p = write_header(p, '$', len);
+	memcpy(p, data, len);
+	p += len;
+	*p++ = '\r';
+	*p++ = '\n';
+	return p;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return false;
-	}
+// arguments at least this large are sent from the caller's buffer
+static const int GATHER_THRESHOLD = 64 * 1024;
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+static bool is_gathered(const QByteArray &arg)
+{
+	return arg.size() >= GATHER_THRESHOLD;
+}
 
-	return false;
+static int bulk_size(int len)
+{
+	return 1 + integer_width(len) + 2 + len + 2;
 }
 
-QStringList QRedis::keys(const QString &pattern)
+redis_arg::redis_arg(const char *str) : data_(str), size_(strlen(str))
 {
-	QList<QByteArray>temp;
-	temp.append("keys");
-	temp.append(pattern.toUtf8());
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return QStringList();
-	}
+redis_arg::redis_arg(const QByteArray &data) : bytes_(data), data_(data.constData()), size_(data.size())
+{
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+}
 
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
-	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
-		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
-		}
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+redis_arg::redis_arg(qlonglong value) : data_(0)
+{
+	size_ = write_integer(digits_, value) - digits_;
+}
 
-	return data;
+redis_arg::redis_arg(int value) : data_(0)
+{
+	size_ = write_integer(digits_, value) - digits_;
 }
 
-bool QRedis::move(const QString &key, int db)
+redis_writer::redis_writer() : m_size(0), m_external(0)
 {
-	QList<QByteArray>temp;
-	temp.append("move");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(db).toUtf8());
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void redis_writer::append(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args)
+{
+	int argc = cmd.size() + args.count();
+	int len = 1 + integer_width(argc) + 2;
+	for (const redis_arg *arg = cmd.begin(); arg != cmd.end(); ++arg)
 	{
-		m_error = "read time out";
-		return false;
+		len += bulk_size(arg->size());
+		if (is_gathered(arg->bytes())) len -= arg->size();
+	}
+	foreach(const QByteArray &arg, args)
+	{
+		len += bulk_size(arg.size());
+		if (is_gathered(arg)) len -= arg.size();
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-	if (rr->type() == REDIS_RESULT_INTEGER)
+	char *p = reserve(len);
+	p = write_header(p, '*', argc);
+	for (const redis_arg *arg = cmd.begin(); arg != cmd.end(); ++arg)
 	{
-		return rr->integer();
+		if (is_gathered(arg->bytes()))
+		{
+			p = reference(p, arg->bytes());
+		}
+		else
+		{
+			p = write_bulk(p, arg->data(), arg->size());
+		}
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	foreach(const QByteArray &arg, args)
 	{
-		m_error = rr->error();
+		if (is_gathered(arg))
+		{
+			p = reference(p, arg);
+		}
+		else
+		{
+			p = write_bulk(p, arg.constData(), arg.size());
+		}
 	}
-
-	return false;
 }
 
-bool QRedis::persist(const QString &key)
+void redis_writer::clear()
 {
-	QList<QByteArray>temp;
-	temp.append("persist");
-	temp.append(key.toUtf8());
+	m_size = 0;
+	m_segments.clear();
+	m_external = 0;
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+int redis_writer::size() const
+{
+	return m_size + m_external;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+qint64 redis_writer::writeTo(QRedisTransport *transport) const
+{
+	if (m_segments.isEmpty())
 	{
-		m_error = "read time out";
-		return false;
+		return transport->write(m_buffer.constData(), m_size);
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	// only the bytes between the large arguments are copied
+	QList<QByteArray> chunks;
+	int offset = 0;
+	foreach(const redis_segment &segment, m_segments)
 	{
-		m_error = rr->error();
+		chunks << QByteArray(m_buffer.constData() + offset, segment.offset - offset) << segment.data;
+		offset = segment.offset;
 	}
-
-	return false;
+	chunks << QByteArray(m_buffer.constData() + offset, m_size - offset);
+	return transport->writev(chunks);
 }
 
-bool QRedis::pexpire(const QString &key, qlonglong mils)
+static void append_from(QByteArray &out, int from, int pos, const char *data, int len)
 {
-	QList<QByteArray>temp;
-	temp.append("pexpire");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(mils).toUtf8());
+	int skip = qBound(0, from - pos, len);
+	out.append(data + skip, len - skip);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+QByteArray redis_writer::toByteArray(int from) const
+{
+	QByteArray data;
+	data.reserve(size() - from);
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	int pos = 0;
+	int offset = 0;
+	foreach(const redis_segment &segment, m_segments)
 	{
-		m_error = "read time out";
-		return false;
+		append_from(data, from, pos, m_buffer.constData() + offset, segment.offset - offset);
+		pos += segment.offset - offset;
+		append_from(data, from, pos, segment.data.constData(), segment.data.size());
+		pos += segment.data.size();
+		offset = segment.offset;
 	}
+	append_from(data, from, pos, m_buffer.constData() + offset, m_size - offset);
+	return data;
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+char *redis_writer::reference(char *p, const QByteArray &data)
+{
+	p = write_header(p, '$', data.size());
+	redis_segment segment;
+	segment.offset = p - m_buffer.constData();
+	segment.data = data;
+	m_segments.append(segment);
+	m_external += data.size();
+	*p++ = '\r';
+	*p++ = '\n';
+	return p;
+}
+
+char *redis_writer::reserve(int len)
+{
+	// grows only; the buffer is reused for every following command
+	if (m_size + len > m_buffer.size())
 	{
-		m_error = rr->error();
+		m_buffer.resize(qMax(m_size + len, m_buffer.size() * 2));
 	}
 
-	return false;
+	char *p = m_buffer.data() + m_size;
+	m_size += len;
+	return p;
 }
 
-bool QRedis::pexpireat(const QString &key, qlonglong milstimestamp)
+redis_parser::redis_parser() : m_state(PARSE_LINE), m_pos(0), m_bulklen(0), m_bulkprefix('$'), m_streamed(0), m_sinkfailed(false), m_visitremaining(0), m_visited(0), m_visitskip(0), m_visitnested(false), m_visitfailed(false), m_arena(0)
 {
-	QList<QByteArray>temp;
-	temp.append("pexpireat");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(milstimestamp).toUtf8());
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return false;
-	}
+redis_parser::~redis_parser()
+{
+	reset();
+}
+
+void redis_parser::feed(const QByteArray &data)
+{
+	if (m_state == PARSE_ERROR) return;
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-	if (rr->type() == REDIS_RESULT_INTEGER)
+	// drop consumed bytes, the unread tail is what has not been parsed yet
+	if (m_pos == m_buffer.size())
 	{
-		return rr->integer();
+		m_buffer = data;
+		m_pos = 0;
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else
 	{
-		m_error = rr->error();
+		if (m_pos > 0)
+		{
+			m_buffer.remove(0, m_pos);
+			m_pos = 0;
+		}
+		m_buffer.append(data);
 	}
 
-	return false;
+	if (m_replies.isEmpty()) parse();
 }
 
-qlonglong QRedis::pttl(const QString &key)
+void redis_parser::setStream(const redis_stream &stream)
 {
-	QList<QByteArray>temp;
-	temp.append("pttl");
-	temp.append(key.toUtf8());
+	m_stream = stream;
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+bool redis_parser::hasReply()
+{
+	if (m_replies.isEmpty()) parse();
+	return !m_replies.isEmpty();
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
-	}
+redis_reply redis_parser::takeReply()
+{
+	if (m_replies.isEmpty()) return redis_reply();
+	return m_replies.dequeue();
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+bool redis_parser::hasError() const
+{
+	return m_state == PARSE_ERROR;
+}
 
-	return 0;
+void redis_parser::reset()
+{
+	delete m_arena;
+	m_arena = 0;
+	m_stack.clear();
+	m_replies.clear();
+
+	m_buffer.clear();
+	m_pos = 0;
+	m_bulklen = 0;
+	m_bulkprefix = '$';
+	m_stream = redis_stream();
+	m_streamed = 0;
+	m_sinkfailed = false;
+	m_visitremaining = 0;
+	m_visited = 0;
+	m_visitskip = 0;
+	m_visitnested = false;
+	m_visitfailed = false;
+	m_state = PARSE_LINE;
 }
 
-QString QRedis::randomkey()
+void redis_parser::parse()
 {
-	QList<QByteArray>temp;
-	temp.append("randomkey");
+	while (m_state != PARSE_ERROR && m_replies.isEmpty())
+	{
+		if (m_state == PARSE_STREAM)
+		{
+			// the payload goes out as it arrives, only its length is kept
+			int len = qMin(m_buffer.size() - m_pos, m_bulklen - m_streamed);
+			if (len > 0 && !m_sinkfailed && m_stream.sink->write(m_buffer.constData() + m_pos, len) != len)
+			{
+				m_sinkfailed = true;
+			}
+			m_pos += len;
+			m_streamed += len;
+			if (m_streamed < m_bulklen || m_buffer.size() - m_pos < 2) return;
+
+			redis_node &n = next();
+			if (m_sinkfailed)
+			{
+				QByteArray message("sink write failed: ");
+				message.append(m_stream.sink->errorString().toUtf8());
+				n.type = REDIS_RESULT_ERROR;
+				n.str.offset = m_arena->bytes.size();
+				n.str.length = message.size();
+				m_arena->bytes.append(message);
+			}
+			else
+			{
+				n.type = REDIS_RESULT_INTEGER;
+				n.integer = m_bulklen;
+			}
+			m_pos += 2;
+			m_streamed = 0;
+			m_sinkfailed = false;
+			m_state = PARSE_LINE;
+			complete();
+			continue;
+		}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+		if (m_state == PARSE_BULK)
+		{
+			if (m_buffer.size() - m_pos < m_bulklen + 2) return;
+
+			const char *data = m_buffer.constData() + m_pos;
+			int len = m_bulklen;
+			if (m_bulkprefix == '=' && len >= 4)
+			{
+				// verbatim string, skip the "txt:" format tag
+				data += 4;
+				len -= 4;
+			}
+			m_pos += m_bulklen + 2;
+			m_state = PARSE_LINE;
+
+			if (m_visitremaining > 0)
+			{
+				visit(data, len);
+				continue;
+			}
+
+			redis_node &n = next();
+			n.type = (m_bulkprefix == '!') ? REDIS_RESULT_ERROR : REDIS_RESULT_STRING;
+			n.str.offset = m_arena->bytes.size();
+			n.str.length = len;
+			m_arena->bytes.append(data, len);
+			complete();
+			continue;
+		}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return "";
-	}
+		int eol = m_buffer.indexOf("\r\n", m_pos);
+		if (eol < 0) return;
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+		char prefix = m_buffer.at(m_pos);
+		const char *line = m_buffer.constData() + m_pos + 1;
+		const char *end = m_buffer.constData() + eol;
+		m_pos = eol + 2;
 
-	if (rr->type() == REDIS_RESULT_STRING)
-	{
-		return rr->string();
+		switch (prefix)
+		{
+		case '-':	// ERROR
+		case '+':	// STATUS
+		case '(':	// BIG NUMBER
+			if (m_visitremaining > 0)
+			{
+				visit(line, end - line);
+			}
+			else
+			{
+				redis_node &n = next();
+				n.type = (prefix == '-') ? REDIS_RESULT_ERROR : (prefix == '+') ? REDIS_RESULT_STATUS : REDIS_RESULT_BIGNUMBER;
+				n.str.offset = m_arena->bytes.size();
+				n.str.length = end - line;
+				m_arena->bytes.append(line, end - line);
+				complete();
+			}
+			break;
+		case ':':	// INTEGER
+			if (m_visitremaining > 0)
+			{
+				visit(line, end - line);
+			}
+			else
+			{
+				redis_node &n = next();
+				n.type = REDIS_RESULT_INTEGER;
+				n.integer = parse_integer(line, end);
+				complete();
+			}
+			break;
+		case ',':	// DOUBLE
+			if (m_visitremaining > 0)
+			{
+				visit(line, end - line);
+			}
+			else
+			{
+				redis_node &n = next();
+				n.type = REDIS_RESULT_DOUBLE;
+				n.real = parse_double(line, end);
+				complete();
+			}
+			break;
+		case '#':	// BOOLEAN
+			if (m_visitremaining > 0)
+			{
+				visit(line, end - line);
+			}
+			else
+			{
+				redis_node &n = next();
+				n.type = REDIS_RESULT_BOOLEAN;
+				n.integer = (line < end && *line == 't');
+				complete();
+			}
+			break;
+		case '_':	// NULL
+			if (m_visitremaining > 0)
+			{
+				visit(0, 0);
+			}
+			else
+			{
+				next().type = REDIS_RESULT_NIL;
+				complete();
+			}
+			break;
+		case '$':	// STRING
+		case '!':	// BLOB ERROR
+		case '=':	// VERBATIM STRING
+			m_bulkprefix = prefix;
+			m_bulklen = parse_integer(line, end);
+			if (m_bulklen < 0 && m_visitremaining > 0)
+			{
+				visit(0, 0);
+			}
+			else if (m_bulklen < 0)
+			{
+				next().type = REDIS_RESULT_NIL;
+				complete();
+			}
+			else
+			{
+				m_state = (prefix == '$' && m_stream.sink && m_stack.isEmpty()) ? PARSE_STREAM : PARSE_BULK;
+			}
+			break;
+		case '*':	// ARRAY
+		case '%':	// MAP
+		case '~':	// SET
+		case '>':	// PUSH
+		case '|':	// ATTRIBUTE
+			{
+				int count = parse_integer(line, end);
+				if (prefix == '%' || prefix == '|') count *= 2;
+
+				// visitors only take arrays of scalars; anything nested is skipped
+				if (m_visitremaining > 0)
+				{
+					if (prefix == '|')
+					{
+						if (m_visitskip == 0) m_visitnested = false;
+						m_visitskip += qMax(count, 0);
+					}
+					else if (count < 0 && m_visitskip == 0)
+					{
+						visit(0, 0);
+					}
+					else
+					{
+						// the header stands in for its elements, so it is skipped as one of them
+						if (m_visitskip == 0)
+						{
+							m_visitnested = true;
+							m_visitskip = 1;
+						}
+						m_visitskip += qMax(count, 0);
+						visit(0, 0);
+					}
+					break;
+				}
+
+				bool visitable = prefix == '*' || prefix == '%' || prefix == '~';
+				if (count > 0 && visitable && m_stream.visitor && m_stack.isEmpty())
+				{
+					m_visitremaining = count;
+					m_visited = 0;
+					break;
+				}
+
+				redis_node &n = next();
+				if (count < 0)
+				{
+					n.type = REDIS_RESULT_NIL;
+					complete();
+					break;
+				}
+				if (count == 0 && prefix == '|')
+				{
+					drop_attribute();
+					break;
+				}
+				if (count == 0 && visitable && m_stream.visitor && m_stack.isEmpty())
+				{
+					n.type = REDIS_RESULT_INTEGER;
+					n.integer = 0;
+					complete();
+					break;
+				}
+
+				// children get one contiguous run of slots, filled in as they arrive
+				n.type = (prefix == '%' || prefix == '|') ? REDIS_RESULT_MAP : (prefix == '~') ? REDIS_RESULT_SET : (prefix == '>') ? REDIS_RESULT_PUSH : REDIS_RESULT_ARRAY;
+				n.count = count;
+				n.first = m_arena->nodes.size();
+				if (count == 0)
+				{
+					complete();
+					break;
+				}
+
+				// n is invalidated by the resize below
+				parse_frame frame = { n.first, count, prefix == '|' };
+				m_arena->nodes.resize(frame.next + count);
+				m_stack.append(frame);
+			}
+			break;
+		default:	// INVALID
+			m_state = PARSE_ERROR;
+			break;
+		}
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+}
+
+redis_node &redis_parser::next()
+{
+	if (m_stack.isEmpty())
 	{
-		m_error = rr->error();
+		m_arena = new redis_arena;
+		m_arena->nodes.resize(1);
+		return m_arena->nodes[0];
 	}
 
-	return "";
+	return m_arena->nodes[m_stack.last().next++];
 }
 
-bool QRedis::rename(const QString &key, const QString &newkey)
+void redis_parser::complete()
 {
-	QList<QByteArray>temp;
-	temp.append("rename");
-	temp.append(key.toUtf8());
-	temp.append(newkey.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	while (!m_stack.isEmpty())
 	{
-		m_error = "read time out";
-		return false;
+		if (--m_stack.last().remaining > 0) return;
+
+		bool attribute = m_stack.last().attribute;
+		m_stack.removeLast();
+		if (attribute)
+		{
+			drop_attribute();
+			return;
+		}
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	m_replies.enqueue(redis_reply(m_arena, 0));
+	m_arena = 0;
+}
 
-	if (rr->type() == REDIS_RESULT_STRING)
+void redis_parser::drop_attribute()
+{
+	// an attribute only annotates the value after it, which takes its slot
+	if (m_stack.isEmpty())
 	{
-		if (rr->string() == "OK") return true;
+		delete m_arena;
+		m_arena = 0;
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else
 	{
-		m_error = rr->error();
+		m_stack.last().next--;
 	}
-
-	return false;
 }
 
-bool QRedis::renamenx(const QString &key, const QString &newkey)
+void redis_parser::visit(const char *data, int len)
 {
-	QList<QByteArray>temp;
-	temp.append("renamenx");
-	temp.append(key.toUtf8());
-	temp.append(newkey.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	if (m_visitskip > 0)
 	{
-		m_error = "read time out";
-		return false;
+		// inside an attribute, which is dropped, or a nested element, which
+		// fails the reply once it ends; the stream goes on either way
+		if (--m_visitskip > 0 || !m_visitnested) return;
+		m_visitfailed = true;
 	}
+	else
+	{
+		// elements are not kept, the reply only carries their count
+		m_stream.visitor(data ? QByteArray(data, len) : QByteArray());
+		m_visited++;
+	}
+	if (--m_visitremaining > 0) return;
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_STRING)
+	redis_node &n = next();
+	if (m_visitfailed)
 	{
-		if (rr->string() == "OK") return true;
+		QByteArray message("nested element in a visited reply");
+		n.type = REDIS_RESULT_ERROR;
+		n.str.offset = m_arena->bytes.size();
+		n.str.length = message.size();
+		m_arena->bytes.append(message);
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else
 	{
-		m_error = rr->error();
+		n.type = REDIS_RESULT_INTEGER;
+		n.integer = m_visited;
 	}
-
-	return false;
+	m_visitfailed = false;
+	complete();
 }
 
-qlonglong QRedis::ttl(const QString &key)
+redis_submit_queue::redis_submit_queue() : m_head(0)
 {
-	QList<QByteArray>temp;
-	temp.append("ttl");
-	temp.append(key.toUtf8());
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+redis_submit_queue::~redis_submit_queue()
+{
+	redis_submission *s = takeAll();
+	while (s)
 	{
-		m_error = "read time out";
-		return 0;
+		redis_submission *next = s->next;
+		delete s;
+		s = next;
 	}
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+bool redis_submit_queue::push(redis_submission *s)
+{
+	redis_submission *head = m_head.load(std::memory_order_relaxed);
+	do
 	{
-		m_error = rr->error();
-	}
+		s->next = head;
+	} while (!m_head.compare_exchange_weak(head, s, std::memory_order_release, std::memory_order_relaxed));
 
-	return 0;
+	// only the push onto an empty queue needs to wake the consumer
+	return head == 0;
 }
 
-QString QRedis::type(const QString &key)
+redis_submission *redis_submit_queue::takeAll()
 {
-	QList<QByteArray>temp;
-	temp.append("type");
-	temp.append(key.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	redis_submission *s = m_head.exchange(0, std::memory_order_acquire);
+	redis_submission *ordered = 0;
+	while (s)
 	{
-		m_error = "read time out";
-		return "";
+		redis_submission *next = s->next;
+		s->next = ordered;
+		ordered = s;
+		s = next;
 	}
+	return ordered;
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+redis_cache::redis_cache() : m_entries(0), m_seq(0), m_flushed(0), m_fetches(0), m_hits(0), m_misses(0)
+{
 
-	if (rr->type() == REDIS_RESULT_STRING)
-	{
-		return rr->string();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+}
 
-	return "";
+void redis_cache::setBudget(int bytes)
+{
+	m_entries.setMaxCost(qMax(0, bytes));
+	if (bytes <= 0) clear();
 }
 
-int QRedis::append(const QString &key, const QString &value)
+int redis_cache::budget() const
 {
-	QList<QByteArray>temp;
-	temp.append("append");
-	temp.append(key.toUtf8());
-	temp.append(value.toUtf8());
+	return m_entries.maxCost();
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+bool redis_cache::isEnabled() const
+{
+	return m_entries.maxCost() > 0;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
-	}
+void redis_cache::setPrefixes(const QList<QByteArray> &prefixes)
+{
+	m_prefixes = prefixes;
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+const QList<QByteArray> &redis_cache::prefixes() const
+{
+	return m_prefixes;
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+bool redis_cache::isCacheable(const QByteArray &key) const
+{
+	if (m_prefixes.isEmpty()) return true;
+	foreach (const QByteArray &prefix, m_prefixes)
 	{
-		m_error = rr->error();
+		if (key.startsWith(prefix)) return true;
 	}
-
-	return 0;
+	return false;
 }
 
-qlonglong QRedis::decr(const QString &key)
+const QList<QByteArray> *redis_cache::find(const QByteArray &key, const QByteArray &sub)
 {
-	QList<QByteArray>temp;
-	temp.append("decr");
-	temp.append(key.toUtf8());
+	redis_cache_entry *entry = m_entries.object(key);
+	if (!entry) return 0;
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	QHash<QByteArray, QList<QByteArray> >::const_iterator it = entry->values.constFind(sub);
+	return it == entry->values.constEnd() ? 0 : &it.value();
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void redis_cache::record(bool hit)
+{
+	if (hit)
 	{
-		m_error = "read time out";
-		return -9999;
+		m_hits++;
 	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_INTEGER)
+	else
 	{
-		return rr->integer();
+		m_misses++;
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+}
+
+quint64 redis_cache::begin()
+{
+	m_fetches++;
+	return ++m_seq;
+}
+
+/*
+ * Bytes charged for an entry, with a rough allowance for the containers.
+ */
+static int cache_cost(const QByteArray &key, const redis_cache_entry &entry)
+{
+	int cost = key.size() + 64;
+	QHash<QByteArray, QList<QByteArray> >::const_iterator it;
+	for (it = entry.values.constBegin(); it != entry.values.constEnd(); ++it)
 	{
-		m_error = rr->error();
+		cost += it.key().size() + 32;
+		foreach (const QByteArray &value, it.value())
+		{
+			cost += value.size() + 16;
+		}
 	}
-
-	return -9999;
+	return cost;
 }
 
-qlonglong QRedis::decrby(const QString &key, qlonglong value)
+void redis_cache::store(const QByteArray &key, const QByteArray &sub, quint64 since, const QList<QByteArray> &values)
 {
-	QList<QByteArray>temp;
-	temp.append("decrby");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(value).toUtf8());
+	if (!since || !isEnabled() || !isCacheable(key)) return;
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	// flushed or invalidated after the fetch began, the reply may be stale
+	if (since <= m_flushed || m_invalidated.value(key) >= since) return;
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return -9999;
-	}
+	redis_cache_entry *entry = new redis_cache_entry;
+	redis_cache_entry *old = m_entries.object(key);
+	if (old) *entry = *old;
+	entry->values.insert(sub, values);
+	m_entries.insert(key, entry, cache_cost(key, *entry));
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+void redis_cache::end(quint64 since)
+{
+	if (!since) return;
+	if (--m_fetches == 0) m_invalidated.clear();
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void redis_cache::invalidate(const QByteArray &key)
+{
+	m_entries.remove(key);
 
-	return -9999;
+	// copied, the key may only view the caller's buffer
+	if (m_fetches > 0) m_invalidated.insert(QByteArray(key.constData(), key.size()), m_seq);
 }
 
-QString QRedis::get(const QString &key)
+void redis_cache::clear()
 {
-	QList<QByteArray>temp;
-	temp.append("get");
-	temp.append(key.toUtf8());
+	m_entries.clear();
+	if (m_fetches > 0) m_flushed = m_seq;
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+qlonglong redis_cache::hits() const
+{
+	return m_hits;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return "";
-	}
+qlonglong redis_cache::misses() const
+{
+	return m_misses;
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+QRedis::QRedis(QObject * parent) : QObject(parent), m_nextid(1)
+{
+	m_batchcount = 0;
+	m_maxbatchcount = 1024;
+	m_maxbatchbytes = 1024 * 1024;
+	m_timeout = 1000;
+	m_nexttimeout = 0;
+	m_hasnexttimeout = false;
+	m_thread = 0;
+	m_owner = 0;
+
+	m_sock = 0;
+	m_subssock = 0;
+	m_backend = QtBackend;
+
+	m_reconnectbase = 100;
+	m_reconnectmax = 30000;
+	m_attempt = 0;
+	m_offlinelimit = 1024;
+	m_readretries = 0;
+	m_db = 0;
+	m_protocol = 2;
+	m_cacheactive = false;
+	m_subsid = -1;
+
+	m_reconnecttimer = new QTimer(this);
+	m_reconnecttimer->setSingleShot(true);
+	connect(m_reconnecttimer, SIGNAL(timeout()), this, SLOT(reconnect()));
+
+	m_flushtimer = new QTimer(this);
+	m_flushtimer->setSingleShot(true);
+	connect(m_flushtimer, SIGNAL(timeout()), this, SLOT(flushPending()));
+
+	m_draining = false;
+	m_replydepth = 0;
+	m_deferredtimer = new QTimer(this);
+	m_deferredtimer->setSingleShot(true);
+	connect(m_deferredtimer, SIGNAL(timeout()), this, SLOT(dispatchDeferred()));
+}
 
-	//QByteArray data;
-	//QCoreApplication::processEvents();
-	//while (m_sock->bytesAvailable())
-	//{
-	//	data += m_sock->readAll();
-	//	m_sock->waitForReadyRead(1000);
-	//}
+QRedis::~QRedis()
+{
+	stopThread();
+}
 
-	if (rr->type() == REDIS_RESULT_STRING)
-	{
-		return rr->string();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::connectHost(const QString & hostName, quint16 port)
+{
+	m_ip = hostName;
+	m_port = port;
+	open(create_transport(hostName, port), create_transport(hostName, port));
+}
 
-	return "";
+void QRedis::setBackend(Backend backend)
+{
+	m_backend = backend;
 }
 
-QString QRedis::getrange(const QString &key, qlonglong start, qlonglong stop)
+QRedisTransport *QRedis::create_transport(const QString &host, quint16 port)
+{
+#ifdef Q_OS_LINUX
+	if (m_backend == EpollBackend) return new QRedisEpollTransport(host, port);
+#endif
+	if (m_backend == UringBackend && QRedisUringTransport::isAvailable()) return new QRedisUringTransport(host, port);
+	return new QRedisTcpTransport(host, port);
+}
+
+void QRedis::connectUnix(const QString &path)
 {
-	QList<QByteArray> temp;
-	temp.append("getrange");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(start).toUtf8());
-	temp.append(QString::number(stop).toUtf8());
+	open(new QRedisLocalTransport(path), new QRedisLocalTransport(path));
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+void QRedis::open(QRedisTransport *sock, QRedisTransport *subssock)
+{
+	if (m_sock)
+	{
+		// disconnected() would schedule a reconnect of the sockets being replaced
+		m_sock->disconnect(this);
+		m_subssock->disconnect(this);
+		m_sock->close();
+		m_subssock->close();
+		m_sock->deleteLater();
+		m_subssock->deleteLater();
+
+		m_reconnecttimer->stop();
+		m_subsparser.reset();
+		m_subsid = -1;
+		m_subsrequests.clear();
+		connection_lost();
+	}
+
+	m_sock = sock;
+	m_sock->setParent(this);
+	connect(m_sock, SIGNAL(readyRead()), this, SLOT(replyRead()));
+	connect(m_sock, SIGNAL(connected()), this, SLOT(connected()));
+	connect(m_sock, SIGNAL(disconnected()), this, SLOT(disconnected()));
+	connect(m_sock, SIGNAL(error()), this, SLOT(error()));
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return "";
-	}
+	m_subssock = subssock;
+	m_subssock->setParent(this);
+	connect(m_subssock, SIGNAL(readyRead()), this, SLOT(readyRead()));
+	connect(m_subssock, SIGNAL(connected()), this, SLOT(connected()));
+	connect(m_subssock, SIGNAL(disconnected()), this, SLOT(disconnected()));
+	connect(m_subssock, SIGNAL(error()), this, SLOT(error()));
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	// the subscriber connection is opened by the first subscribe
+	bool subscribed = uses_subscriber();
+	m_attempt = 0;
+	m_sock->open();
+	if (subscribed) m_subssock->open();
 
-	if (rr->type() == REDIS_RESULT_STRING)
+	// both connects are in flight together and share one deadline
+	QElapsedTimer timer;
+	timer.start();
+	if (!m_sock->waitForConnected(m_timeout))
 	{
-		return rr->string();
+		m_sock->close();
+		schedule_reconnect();
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+
+	if (subscribed)
 	{
-		m_error = rr->error();
+		int remaining = m_timeout < 0 ? -1 : qMax(0, m_timeout - int(timer.elapsed()));
+		if (!m_subssock->waitForConnected(remaining))
+		{
+			m_subssock->close();
+			schedule_reconnect();
+		}
 	}
+}
 
-	return "";
+void QRedis::setReconnect(int baseMsecs, int maxMsecs, int queueLimit)
+{
+	m_reconnectbase = qMax(1, baseMsecs);
+	m_reconnectmax = qMax(m_reconnectbase, maxMsecs);
+	m_offlinelimit = queueLimit;
 }
 
-QString QRedis::getset(const QString &key, const QString &value)
+void QRedis::setReadRetries(int retries)
 {
-	QList<QByteArray> temp;
-	temp.append("getset");
-	temp.append(key.toUtf8());
-	temp.append(value.toUtf8());
+	m_readretries = retries;
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+/*
+ * Result slot of a command() made from outside the I/O thread.
+ */
+struct redis_thread_reply
+{
+	QSemaphore done;
+	redis_reply reply;
+};
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return "";
-	}
+redis_reply QRedis::command(const QList<QByteArray> &cmd)
+{
+	if (cmd.isEmpty()) return redis_reply::fromError("empty command");
+	if (!m_thread || QThread::currentThread() == thread()) return execute({}, cmd);
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	QSharedPointer<redis_thread_reply> wait(new redis_thread_reply);
+	submit(cmd, [wait](const redis_reply &rr)
+	{
+		wait->reply = rr;
+		wait->done.release();
+	});
+	if (!wait->done.tryAcquire(1, m_timeout)) return redis_reply::fromError("read time out");
+	return wait->reply;
+}
 
-	if (rr->type() == REDIS_RESULT_STRING)
+void QRedis::command(const QList<QByteArray> &cmd, const redis_callback &callback)
+{
+	if (cmd.isEmpty())
 	{
-		return rr->string();
+		callback(redis_reply::fromError("empty command"));
+		return;
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	if (m_thread && QThread::currentThread() != thread())
 	{
-		m_error = rr->error();
+		submit(cmd, callback);
+		return;
 	}
-
-	return "";
+	send({}, cmd, callback);
 }
 
-qlonglong QRedis::incr(const QString &key)
+bool QRedis::startThread()
 {
-	QList<QByteArray>temp;
-	temp.append("incr");
-	temp.append(key.toUtf8());
+	if (m_thread || parent()) return false;
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	qRegisterMetaType<redis_reply>("redis_reply");
+	qRegisterMetaType<quint64>("quint64");
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return -9999;
-	}
+	m_owner = thread();
+	m_thread = new QThread;
+	moveToThread(m_thread);
+	m_thread->start();
+	return true;
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+void QRedis::stopThread()
+{
+	if (!m_thread) return;
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
+	// moveToThread() has to be called from the thread the object lives in
+	if (QThread::currentThread() == thread())
 	{
-		return rr->integer();
+		detachThread();
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else
 	{
-		m_error = rr->error();
+		QMetaObject::invokeMethod(this, "detachThread", Qt::BlockingQueuedConnection);
 	}
-
-	return -9999;
+	m_thread->quit();
+	m_thread->wait();
+	delete m_thread;
+	m_thread = 0;
 }
 
-qlonglong QRedis::incrby(const QString &key, qlonglong value)
+void QRedis::detachThread()
 {
-	QList<QByteArray>temp;
-	temp.append("incrby");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(value).toUtf8());
+	moveToThread(m_owner);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+quint64 QRedis::submit(const QList<QByteArray> &cmd, const redis_callback &callback)
+{
+	quint64 id = m_nextid++;
+	redis_submission *s = new redis_submission;
+	s->id = id;
+	s->cmd = cmd;
+	s->callback = callback;
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	// s belongs to the I/O thread once pushed
+	if (m_submissions.push(s))
 	{
-		m_error = "read time out";
-		return -9999;
+		QMetaObject::invokeMethod(this, "drainSubmissions", Qt::QueuedConnection);
 	}
+	return id;
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::drainSubmissions()
+{
+	redis_submission *s = m_submissions.takeAll();
+	while (s)
 	{
-		m_error = rr->error();
+		quint64 id = s->id;
+		redis_callback callback = s->callback;
+		if (s->cmd.isEmpty())
+		{
+			redis_reply rr = redis_reply::fromError("empty command");
+			if (callback) callback(rr);
+			emit completed(id, rr);
+		}
+		else
+		{
+			send({}, s->cmd, [this, id, callback](const redis_reply &rr)
+			{
+				if (callback) callback(rr);
+				emit completed(id, rr);
+			});
+		}
+
+		redis_submission *next = s->next;
+		delete s;
+		s = next;
 	}
 
-	return -9999;
+	// everything drained in this pass goes out as one write
+	flushPending();
 }
 
-qreal QRedis::incrbyfloat(const QString &key, qreal value)
+qlonglong QRedis::get(const QString &key, QIODevice *sink)
 {
-	QList<QByteArray>temp;
-	temp.append("incrbyfloat");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(value).toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	return getRaw(key.toUtf8(), sink);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0.0;
-	}
+void QRedis::get(const QString &key, QIODevice *sink, const redis_integer_callback &callback)
+{
+	getRaw(key.toUtf8(), sink, callback);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+qlonglong QRedis::getRaw(const QByteArray &key, QIODevice *sink)
+{
+	return reply_integer(execute({"get", key}, QList<QByteArray>(), sink), -1);
+}
 
-	if (rr->type() == REDIS_RESULT_STRING)
-	{
-		return rr->string().toDouble();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::getRaw(const QByteArray &key, QIODevice *sink, const redis_integer_callback &callback)
+{
+	send({"get", key}, QList<QByteArray>(), [this, callback](const redis_reply &rr)
 	{
-		m_error = rr->error();
-	}
+		callback(reply_integer(rr, -1));
+	}, sink);
+}
 
-	return 0.0;
+qlonglong QRedis::getrange(const QString &key, qlonglong start, qlonglong stop, QIODevice *sink)
+{
+	return getrangeRaw(key.toUtf8(), start, stop, sink);
 }
 
-QStringList QRedis::mget(const QStringList &keys)
+void QRedis::getrange(const QString &key, qlonglong start, qlonglong stop, QIODevice *sink, const redis_integer_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("mget");
-	foreach(QString key, keys)
-	{
-		temp.append(key.toUtf8());
-	}
+	getrangeRaw(key.toUtf8(), start, stop, sink, callback);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+qlonglong QRedis::getrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop, QIODevice *sink)
+{
+	return reply_integer(execute({"getrange", key, start, stop}, QList<QByteArray>(), sink), -1);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::getrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop, QIODevice *sink, const redis_integer_callback &callback)
+{
+	send({"getrange", key, start, stop}, QList<QByteArray>(), [this, callback](const redis_reply &rr)
 	{
-		m_error = "read time out";
-		return QStringList();
-	}
+		callback(reply_integer(rr, -1));
+	}, sink);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+/*
+ * Turns the alternating fields and values of a hash reply into pairs. The
+ * state is shared, since the parser works on copies of the visitor.
+ */
+struct redis_pair_state
+{
+	redis_pair_state() : hasfield(false) {}
+	QByteArray field;
+	bool hasfield;
+};
 
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
+static redis_bytes_callback pair_visitor(const redis_bytes_pair_callback &visitor)
+{
+	QSharedPointer<redis_pair_state> state(new redis_pair_state);
+	return [visitor, state](const QByteArray &element)
 	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
+		if (!state->hasfield)
 		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
+			state->field = element;
+			state->hasfield = true;
+			return;
 		}
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
-
-	return data;
+		state->hasfield = false;
+		visitor(state->field, element);
+	};
 }
 
-void QRedis::mset(const QStringList &keyvalues)
+qlonglong QRedis::hgetallEach(const QString &key, const redis_string_pair_callback &visitor)
 {
-	QList<QByteArray>temp;
-	temp.append("mset");
-	foreach(QString kv, keyvalues)
+	return hgetallEachRaw(key.toUtf8(), [visitor](const QByteArray &field, const QByteArray &value)
 	{
-		temp.append(kv.toUtf8());
-	}
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+		visitor(from_utf8(field), from_utf8(value));
+	});
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::hgetallEach(const QString &key, const redis_string_pair_callback &visitor, const redis_integer_callback &callback)
+{
+	hgetallEachRaw(key.toUtf8(), [visitor](const QByteArray &field, const QByteArray &value)
 	{
-		m_error = "read time out";
-		return;
-	}
+		visitor(from_utf8(field), from_utf8(value));
+	}, callback);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+qlonglong QRedis::hgetallEachRaw(const QByteArray &key, const redis_bytes_pair_callback &visitor)
+{
+	qlonglong count = reply_integer(execute({"hgetall", key}, QList<QByteArray>(), pair_visitor(visitor)), -1);
+	return count < 0 ? count : count / 2;
+}
 
-	if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::hgetallEachRaw(const QByteArray &key, const redis_bytes_pair_callback &visitor, const redis_integer_callback &callback)
+{
+	send({"hgetall", key}, QList<QByteArray>(), [this, callback](const redis_reply &rr)
 	{
-		m_error = rr->error();
-	}
+		qlonglong count = reply_integer(rr, -1);
+		callback(count < 0 ? count : count / 2);
+	}, pair_visitor(visitor));
 }
 
-bool QRedis::msetnx(const QStringList &keyvalues)
+qlonglong QRedis::hkeysEach(const QString &key, const redis_string_callback &visitor)
 {
-	QList<QByteArray>temp;
-	temp.append("msetnx");
-	foreach(QString kv, keyvalues)
+	return hkeysEachRaw(key.toUtf8(), [visitor](const QByteArray &element)
 	{
-		temp.append(kv.toUtf8());
-	}
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+		visitor(from_utf8(element));
+	});
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::hkeysEach(const QString &key, const redis_string_callback &visitor, const redis_integer_callback &callback)
+{
+	hkeysEachRaw(key.toUtf8(), [visitor](const QByteArray &element)
 	{
-		m_error = "read time out";
-		return false;
-	}
+		visitor(from_utf8(element));
+	}, callback);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+qlonglong QRedis::hkeysEachRaw(const QByteArray &key, const redis_bytes_callback &visitor)
+{
+	return reply_integer(execute({"hkeys", key}, QList<QByteArray>(), visitor), -1);
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::hkeysEachRaw(const QByteArray &key, const redis_bytes_callback &visitor, const redis_integer_callback &callback)
+{
+	send({"hkeys", key}, QList<QByteArray>(), [this, callback](const redis_reply &rr)
 	{
-		m_error = rr->error();
-	}
-
-	return false;
+		callback(reply_integer(rr, -1));
+	}, visitor);
 }
 
-bool QRedis::psetex(const QString &key, qlonglong mils, const QString &value)
+qlonglong QRedis::hvalsEach(const QString &key, const redis_string_callback &visitor)
 {
-	QList<QByteArray>temp;
-	temp.append("psetex");
-	temp.append(QString::number(mils).toUtf8());
-	temp.append(value.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	return hvalsEachRaw(key.toUtf8(), [visitor](const QByteArray &element)
 	{
-		m_error = "read time out";
-		return false;
-	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+		visitor(from_utf8(element));
+	});
+}
 
-	if (rr->type() == REDIS_RESULT_STRING)
-	{
-		if (rr->string() == "OK") return true;
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::hvalsEach(const QString &key, const redis_string_callback &visitor, const redis_integer_callback &callback)
+{
+	hvalsEachRaw(key.toUtf8(), [visitor](const QByteArray &element)
 	{
-		m_error = rr->error();
-	}
+		visitor(from_utf8(element));
+	}, callback);
+}
 
-	return false;
+qlonglong QRedis::hvalsEachRaw(const QByteArray &key, const redis_bytes_callback &visitor)
+{
+	return reply_integer(execute({"hvals", key}, QList<QByteArray>(), visitor), -1);
 }
 
-bool QRedis::set(const QString &key, const QString &value)
+void QRedis::hvalsEachRaw(const QByteArray &key, const redis_bytes_callback &visitor, const redis_integer_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("set");
-	temp.append(key.toUtf8());
-	temp.append(value.toUtf8());
+	send({"hvals", key}, QList<QByteArray>(), [this, callback](const redis_reply &rr)
+	{
+		callback(reply_integer(rr, -1));
+	}, visitor);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+qlonglong QRedis::lrangeEach(const QString &key, qlonglong start, qlonglong stop, const redis_string_callback &visitor)
+{
+	return lrangeEachRaw(key.toUtf8(), start, stop, [visitor](const QByteArray &element)
+	{
+		visitor(from_utf8(element));
+	});
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::lrangeEach(const QString &key, qlonglong start, qlonglong stop, const redis_string_callback &visitor, const redis_integer_callback &callback)
+{
+	lrangeEachRaw(key.toUtf8(), start, stop, [visitor](const QByteArray &element)
 	{
-		m_error = "read time out";
-		return false;
-	}
+		visitor(from_utf8(element));
+	}, callback);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+qlonglong QRedis::lrangeEachRaw(const QByteArray &key, qlonglong start, qlonglong stop, const redis_bytes_callback &visitor)
+{
+	return reply_integer(execute({"lrange", key, start, stop}, QList<QByteArray>(), visitor), -1);
+}
 
-	if (rr->type() == REDIS_RESULT_STATUS && (rr->string() == "OK"))
-	{
-		return true;
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::lrangeEachRaw(const QByteArray &key, qlonglong start, qlonglong stop, const redis_bytes_callback &visitor, const redis_integer_callback &callback)
+{
+	send({"lrange", key, start, stop}, QList<QByteArray>(), [this, callback](const redis_reply &rr)
 	{
-		m_error = rr->error();
-	}
-
-	return false;
+		callback(reply_integer(rr, -1));
+	}, visitor);
 }
 
-bool QRedis::setex(const QString &key, qlonglong secs, const QString &value)
+qlonglong QRedis::smembersEach(const QString &key, const redis_string_callback &visitor)
 {
-	QList<QByteArray>temp;
-	temp.append("setex");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(secs).toUtf8());
-	temp.append(value.toUtf8());
+	return smembersEachRaw(key.toUtf8(), [visitor](const QByteArray &element)
+	{
+		visitor(from_utf8(element));
+	});
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+void QRedis::smembersEach(const QString &key, const redis_string_callback &visitor, const redis_integer_callback &callback)
+{
+	smembersEachRaw(key.toUtf8(), [visitor](const QByteArray &element)
+	{
+		visitor(from_utf8(element));
+	}, callback);
+}
+
+qlonglong QRedis::smembersEachRaw(const QByteArray &key, const redis_bytes_callback &visitor)
+{
+	return reply_integer(execute({"smembers", key}, QList<QByteArray>(), visitor), -1);
+}
+
+void QRedis::smembersEachRaw(const QByteArray &key, const redis_bytes_callback &visitor, const redis_integer_callback &callback)
+{
+	send({"smembers", key}, QList<QByteArray>(), [this, callback](const redis_reply &rr)
+	{
+		callback(reply_integer(rr, -1));
+	}, visitor);
+}
+
+int QRedis::del(const QString &key)
+{
+	return execute(redis_commands::del, key.toUtf8());
+}
+
+void QRedis::del(const QString &key, const redis_integer_callback &callback)
+{
+	send(redis_commands::del, callback, key.toUtf8());
+}
+
+int QRedis::del(const QStringList &keys)
+{
+	return execute(redis_commands::del, to_utf8(keys));
+}
+
+void QRedis::del(const QStringList &keys, const redis_integer_callback &callback)
+{
+	send(redis_commands::del, callback, to_utf8(keys));
+}
+
+bool QRedis::exists(const QString &key)
+{
+	return execute(redis_commands::exists, key.toUtf8());
+}
+
+void QRedis::exists(const QString &key, const redis_bool_callback &callback)
+{
+	send(redis_commands::exists, callback, key.toUtf8());
+}
+
+bool QRedis::expire(const QString &key, qlonglong secs)
+{
+	return execute(redis_commands::expire, key.toUtf8(), secs);
+}
+
+void QRedis::expire(const QString &key, qlonglong secs, const redis_bool_callback &callback)
+{
+	send(redis_commands::expire, callback, key.toUtf8(), secs);
+}
+
+bool QRedis::expireat(const QString &key, qlonglong timestamp)
+{
+	return execute(redis_commands::expireat, key.toUtf8(), timestamp);
+}
+
+void QRedis::expireat(const QString &key, qlonglong timestamp, const redis_bool_callback &callback)
+{
+	send(redis_commands::expireat, callback, key.toUtf8(), timestamp);
+}
+
+QStringList QRedis::keys(const QString &pattern)
+{
+	return execute(redis_commands::keys, pattern.toUtf8());
+}
+
+void QRedis::keys(const QString &pattern, const redis_string_list_callback &callback)
+{
+	send(redis_commands::keys, callback, pattern.toUtf8());
+}
+
+bool QRedis::move(const QString &key, int db)
+{
+	return execute(redis_commands::move, key.toUtf8(), db);
+}
+
+void QRedis::move(const QString &key, int db, const redis_bool_callback &callback)
+{
+	send(redis_commands::move, callback, key.toUtf8(), db);
+}
+
+bool QRedis::persist(const QString &key)
+{
+	return execute(redis_commands::persist, key.toUtf8());
+}
+
+void QRedis::persist(const QString &key, const redis_bool_callback &callback)
+{
+	send(redis_commands::persist, callback, key.toUtf8());
+}
+
+bool QRedis::pexpire(const QString &key, qlonglong mils)
+{
+	return execute(redis_commands::pexpire, key.toUtf8(), mils);
+}
+
+void QRedis::pexpire(const QString &key, qlonglong mils, const redis_bool_callback &callback)
+{
+	send(redis_commands::pexpire, callback, key.toUtf8(), mils);
+}
+
+bool QRedis::pexpireat(const QString &key, qlonglong milstimestamp)
+{
+	return execute(redis_commands::pexpireat, key.toUtf8(), milstimestamp);
+}
+
+void QRedis::pexpireat(const QString &key, qlonglong milstimestamp, const redis_bool_callback &callback)
+{
+	send(redis_commands::pexpireat, callback, key.toUtf8(), milstimestamp);
+}
+
+qlonglong QRedis::pttl(const QString &key)
+{
+	return execute(redis_commands::pttl, key.toUtf8());
+}
+
+void QRedis::pttl(const QString &key, const redis_integer_callback &callback)
+{
+	send(redis_commands::pttl, callback, key.toUtf8());
+}
+
+QString QRedis::randomkey()
+{
+	return execute(redis_commands::randomkey);
+}
+
+void QRedis::randomkey(const redis_string_callback &callback)
+{
+	send(redis_commands::randomkey, callback);
+}
+
+bool QRedis::rename(const QString &key, const QString &newkey)
+{
+	return execute(redis_commands::rename, key.toUtf8(), newkey.toUtf8());
+}
+
+void QRedis::rename(const QString &key, const QString &newkey, const redis_bool_callback &callback)
+{
+	send(redis_commands::rename, callback, key.toUtf8(), newkey.toUtf8());
+}
+
+bool QRedis::renamenx(const QString &key, const QString &newkey)
+{
+	return execute(redis_commands::renamenx, key.toUtf8(), newkey.toUtf8());
+}
+
+void QRedis::renamenx(const QString &key, const QString &newkey, const redis_bool_callback &callback)
+{
+	send(redis_commands::renamenx, callback, key.toUtf8(), newkey.toUtf8());
+}
+
+qlonglong QRedis::ttl(const QString &key)
+{
+	return execute(redis_commands::ttl, key.toUtf8());
+}
+
+void QRedis::ttl(const QString &key, const redis_integer_callback &callback)
+{
+	send(redis_commands::ttl, callback, key.toUtf8());
+}
+
+QString QRedis::type(const QString &key)
+{
+	return execute(redis_commands::type, key.toUtf8());
+}
+
+void QRedis::type(const QString &key, const redis_string_callback &callback)
+{
+	send(redis_commands::type, callback, key.toUtf8());
+}
+
+int QRedis::append(const QString &key, const QString &value)
+{
+	return appendRaw(key.toUtf8(), value.toUtf8());
+}
+
+void QRedis::append(const QString &key, const QString &value, const redis_integer_callback &callback)
+{
+	appendRaw(key.toUtf8(), value.toUtf8(), callback);
+}
+
+int QRedis::appendRaw(const QByteArray &key, const QByteArray &value)
+{
+	return execute(redis_commands::append, key, value);
+}
+
+void QRedis::appendRaw(const QByteArray &key, const QByteArray &value, const redis_integer_callback &callback)
+{
+	send(redis_commands::append, callback, key, value);
+}
+
+qlonglong QRedis::decr(const QString &key)
+{
+	return execute(redis_commands::decr, key.toUtf8());
+}
+
+void QRedis::decr(const QString &key, const redis_integer_callback &callback)
+{
+	send(redis_commands::decr, callback, key.toUtf8());
+}
+
+qlonglong QRedis::decrby(const QString &key, qlonglong value)
+{
+	return execute(redis_commands::decrby, key.toUtf8(), value);
+}
+
+void QRedis::decrby(const QString &key, qlonglong value, const redis_integer_callback &callback)
+{
+	send(redis_commands::decrby, callback, key.toUtf8(), value);
+}
+
+QString QRedis::get(const QString &key)
+{
+	return from_utf8(getRaw(key.toUtf8()));
+}
+
+void QRedis::get(const QString &key, const redis_string_callback &callback)
+{
+	getRaw(key.toUtf8(), [callback](const QByteArray &value)
+	{
+		callback(from_utf8(value));
+	});
+}
+
+QByteArray QRedis::getRaw(const QByteArray &key)
+{
+	QList<QByteArray> values;
+	if (cache_lookup(key, "get", values)) return values.first();
+
+	quint64 since = cache_begin();
+	redis_reply rr = execute({"get", key});
+	QByteArray value = reply_bytes(rr);
+	cache_store(key, "get", since, rr, QList<QByteArray>() << value);
+	return value;
+}
+
+void QRedis::getRaw(const QByteArray &key, const redis_bytes_callback &callback)
+{
+	QList<QByteArray> values;
+	if (cache_lookup(key, "get", values))
+	{
+		callback(values.first());
+		return;
+	}
+
+	quint64 since = cache_begin();
+	send({"get", key}, [this, key, since, callback](const redis_reply &rr)
+	{
+		QByteArray value = reply_bytes(rr);
+		cache_store(key, "get", since, rr, QList<QByteArray>() << value);
+		callback(value);
+	});
+}
+
+QString QRedis::getrange(const QString &key, qlonglong start, qlonglong stop)
+{
+	return from_utf8(getrangeRaw(key.toUtf8(), start, stop));
+}
+
+void QRedis::getrange(const QString &key, qlonglong start, qlonglong stop, const redis_string_callback &callback)
+{
+	getrangeRaw(key.toUtf8(), start, stop, [callback](const QByteArray &value)
+	{
+		callback(from_utf8(value));
+	});
+}
+
+QByteArray QRedis::getrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop)
+{
+	return execute(redis_commands::getrange, key, start, stop);
+}
+
+void QRedis::getrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop, const redis_bytes_callback &callback)
+{
+	send(redis_commands::getrange, callback, key, start, stop);
+}
+
+QString QRedis::getset(const QString &key, const QString &value)
+{
+	return from_utf8(getsetRaw(key.toUtf8(), value.toUtf8()));
+}
+
+void QRedis::getset(const QString &key, const QString &value, const redis_string_callback &callback)
+{
+	getsetRaw(key.toUtf8(), value.toUtf8(), [callback](const QByteArray &value)
+	{
+		callback(from_utf8(value));
+	});
+}
+
+QByteArray QRedis::getsetRaw(const QByteArray &key, const QByteArray &value)
+{
+	return execute(redis_commands::getset, key, value);
+}
+
+void QRedis::getsetRaw(const QByteArray &key, const QByteArray &value, const redis_bytes_callback &callback)
+{
+	send(redis_commands::getset, callback, key, value);
+}
+
+qlonglong QRedis::incr(const QString &key)
+{
+	return execute(redis_commands::incr, key.toUtf8());
+}
+
+void QRedis::incr(const QString &key, const redis_integer_callback &callback)
+{
+	send(redis_commands::incr, callback, key.toUtf8());
+}
+
+qlonglong QRedis::incrby(const QString &key, qlonglong value)
+{
+	return execute(redis_commands::incrby, key.toUtf8(), value);
+}
+
+void QRedis::incrby(const QString &key, qlonglong value, const redis_integer_callback &callback)
+{
+	send(redis_commands::incrby, callback, key.toUtf8(), value);
+}
+
+qreal QRedis::incrbyfloat(const QString &key, qreal value)
+{
+	return execute(redis_commands::incrbyfloat, key.toUtf8(), QByteArray::number(value));
+}
+
+void QRedis::incrbyfloat(const QString &key, qreal value, const redis_real_callback &callback)
+{
+	send(redis_commands::incrbyfloat, callback, key.toUtf8(), QByteArray::number(value));
+}
+
+QStringList QRedis::mget(const QStringList &keys)
+{
+	return from_utf8(mgetRaw(to_utf8(keys)));
+}
+
+void QRedis::mget(const QStringList &keys, const redis_string_list_callback &callback)
+{
+	mgetRaw(to_utf8(keys), [callback](const QList<QByteArray> &value)
+	{
+		callback(from_utf8(value));
+	});
+}
+
+QList<QByteArray> QRedis::mgetRaw(const QList<QByteArray> &keys)
+{
+	QList<QByteArray> values;
+	if (cache_lookup(keys, values)) return values;
+
+	quint64 since = cache_begin();
+	redis_reply rr = execute({"mget"}, keys);
+	values = reply_list(rr);
+	cache_store(keys, since, rr, values);
+	return values;
+}
+
+void QRedis::mgetRaw(const QList<QByteArray> &keys, const redis_bytes_list_callback &callback)
+{
+	QList<QByteArray> values;
+	if (cache_lookup(keys, values))
+	{
+		callback(values);
+		return;
+	}
+
+	quint64 since = cache_begin();
+	send({"mget"}, keys, [this, keys, since, callback](const redis_reply &rr)
+	{
+		QList<QByteArray> values = reply_list(rr);
+		cache_store(keys, since, rr, values);
+		callback(values);
+	});
+}
+
+void QRedis::mset(const QStringList &keyvalues)
+{
+	msetRaw(to_utf8(keyvalues));
+}
+
+void QRedis::mset(const QStringList &keyvalues, const redis_done_callback &callback)
+{
+	msetRaw(to_utf8(keyvalues), callback);
+}
+
+void QRedis::msetRaw(const QList<QByteArray> &keyvalues)
+{
+	execute(redis_commands::mset, keyvalues);
+}
+
+void QRedis::msetRaw(const QList<QByteArray> &keyvalues, const redis_done_callback &callback)
+{
+	send(redis_commands::mset, callback, keyvalues);
+}
+
+bool QRedis::msetnx(const QStringList &keyvalues)
+{
+	return msetnxRaw(to_utf8(keyvalues));
+}
+
+void QRedis::msetnx(const QStringList &keyvalues, const redis_bool_callback &callback)
+{
+	msetnxRaw(to_utf8(keyvalues), callback);
+}
+
+bool QRedis::msetnxRaw(const QList<QByteArray> &keyvalues)
+{
+	return execute(redis_commands::msetnx, keyvalues);
+}
+
+void QRedis::msetnxRaw(const QList<QByteArray> &keyvalues, const redis_bool_callback &callback)
+{
+	send(redis_commands::msetnx, callback, keyvalues);
+}
+
+bool QRedis::psetex(const QString &key, qlonglong mils, const QString &value)
+{
+	return psetexRaw(key.toUtf8(), mils, value.toUtf8());
+}
+
+void QRedis::psetex(const QString &key, qlonglong mils, const QString &value, const redis_bool_callback &callback)
+{
+	psetexRaw(key.toUtf8(), mils, value.toUtf8(), callback);
+}
+
+bool QRedis::psetexRaw(const QByteArray &key, qlonglong mils, const QByteArray &value)
+{
+	return execute(redis_commands::psetex, key, mils, value);
+}
+
+void QRedis::psetexRaw(const QByteArray &key, qlonglong mils, const QByteArray &value, const redis_bool_callback &callback)
+{
+	send(redis_commands::psetex, callback, key, mils, value);
+}
+
+bool QRedis::set(const QString &key, const QString &value)
+{
+	return setRaw(key.toUtf8(), value.toUtf8());
+}
+
+void QRedis::set(const QString &key, const QString &value, const redis_bool_callback &callback)
+{
+	setRaw(key.toUtf8(), value.toUtf8(), callback);
+}
+
+bool QRedis::setRaw(const QByteArray &key, const QByteArray &value)
+{
+	return execute(redis_commands::set, key, value);
+}
+
+void QRedis::setRaw(const QByteArray &key, const QByteArray &value, const redis_bool_callback &callback)
+{
+	send(redis_commands::set, callback, key, value);
+}
+
+bool QRedis::setex(const QString &key, qlonglong secs, const QString &value)
+{
+	return setexRaw(key.toUtf8(), secs, value.toUtf8());
+}
+
+void QRedis::setex(const QString &key, qlonglong secs, const QString &value, const redis_bool_callback &callback)
+{
+	setexRaw(key.toUtf8(), secs, value.toUtf8(), callback);
+}
+
+bool QRedis::setexRaw(const QByteArray &key, qlonglong secs, const QByteArray &value)
+{
+	return execute(redis_commands::setex, key, secs, value);
+}
+
+void QRedis::setexRaw(const QByteArray &key, qlonglong secs, const QByteArray &value, const redis_bool_callback &callback)
+{
+	send(redis_commands::setex, callback, key, secs, value);
+}
+
+bool QRedis::setnx(const QString &key, const QString &value)
+{
+	return setnxRaw(key.toUtf8(), value.toUtf8());
+}
+
+void QRedis::setnx(const QString &key, const QString &value, const redis_bool_callback &callback)
+{
+	setnxRaw(key.toUtf8(), value.toUtf8(), callback);
+}
+
+bool QRedis::setnxRaw(const QByteArray &key, const QByteArray &value)
+{
+	return execute(redis_commands::setnx, key, value);
+}
+
+void QRedis::setnxRaw(const QByteArray &key, const QByteArray &value, const redis_bool_callback &callback)
+{
+	send(redis_commands::setnx, callback, key, value);
+}
+
+qlonglong QRedis::setrange(const QString &key, qlonglong offset, const QString &value)
+{
+	return setrangeRaw(key.toUtf8(), offset, value.toUtf8());
+}
+
+void QRedis::setrange(const QString &key, qlonglong offset, const QString &value, const redis_integer_callback &callback)
+{
+	setrangeRaw(key.toUtf8(), offset, value.toUtf8(), callback);
+}
+
+qlonglong QRedis::setrangeRaw(const QByteArray &key, qlonglong offset, const QByteArray &value)
+{
+	return execute(redis_commands::setrange, key, offset, value);
+}
+
+void QRedis::setrangeRaw(const QByteArray &key, qlonglong offset, const QByteArray &value, const redis_integer_callback &callback)
+{
+	send(redis_commands::setrange, callback, key, offset, value);
+}
+
+qlonglong QRedis::strlen(const QString &key)
+{
+	return execute(redis_commands::strlen, key.toUtf8());
+}
+
+void QRedis::strlen(const QString &key, const redis_integer_callback &callback)
+{
+	send(redis_commands::strlen, callback, key.toUtf8());
+}
+
+qlonglong QRedis::hdel(const QString &key, const QString &field)
+{
+	return hdelRaw(key.toUtf8(), field.toUtf8());
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return false;
-	}
+void QRedis::hdel(const QString &key, const QString &field, const redis_integer_callback &callback)
+{
+	hdelRaw(key.toUtf8(), field.toUtf8(), callback);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+qlonglong QRedis::hdelRaw(const QByteArray &key, const QByteArray &field)
+{
+	return execute(redis_commands::hdel, key, field);
+}
 
-	if (rr->type() == REDIS_RESULT_STATUS && (rr->string() == "OK"))
-	{
-		return true;
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::hdelRaw(const QByteArray &key, const QByteArray &field, const redis_integer_callback &callback)
+{
+	send(redis_commands::hdel, callback, key, field);
+}
 
-	return false;
+qlonglong QRedis::hdel(const QString &key, const QStringList &fields)
+{
+	return hdelRaw(key.toUtf8(), to_utf8(fields));
 }
 
-bool QRedis::setnx(const QString &key, const QString &value)
+void QRedis::hdel(const QString &key, const QStringList &fields, const redis_integer_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("setnx");
-	temp.append(key.toUtf8());
-	temp.append(value.toUtf8());
+	hdelRaw(key.toUtf8(), to_utf8(fields), callback);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+qlonglong QRedis::hdelRaw(const QByteArray &key, const QList<QByteArray> &fields)
+{
+	return execute(redis_commands::hdel, key, fields);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return false;
-	}
+void QRedis::hdelRaw(const QByteArray &key, const QList<QByteArray> &fields, const redis_integer_callback &callback)
+{
+	send(redis_commands::hdel, callback, key, fields);
+}
+
+bool QRedis::hexists(const QString &key, const QString &field)
+{
+	return execute(redis_commands::hexists, key.toUtf8(), field.toUtf8());
+}
+
+void QRedis::hexists(const QString &key, const QString &field, const redis_bool_callback &callback)
+{
+	send(redis_commands::hexists, callback, key.toUtf8(), field.toUtf8());
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+QString QRedis::hget(const QString &key, const QString &field)
+{
+	return from_utf8(hgetRaw(key.toUtf8(), field.toUtf8()));
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER )
+void QRedis::hget(const QString &key, const QString &field, const redis_string_callback &callback)
+{
+	hgetRaw(key.toUtf8(), field.toUtf8(), [callback](const QByteArray &value)
 	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+		callback(from_utf8(value));
+	});
+}
+
+QByteArray QRedis::hgetRaw(const QByteArray &key, const QByteArray &field)
+{
+	QByteArray sub = QByteArray("hget ") + field;
+	QList<QByteArray> values;
+	if (cache_lookup(key, sub, values)) return values.first();
+
+	quint64 since = cache_begin();
+	redis_reply rr = execute({"hget", key, field});
+	QByteArray value = reply_bytes(rr);
+	cache_store(key, sub, since, rr, QList<QByteArray>() << value);
+	return value;
+}
+
+void QRedis::hgetRaw(const QByteArray &key, const QByteArray &field, const redis_bytes_callback &callback)
+{
+	QByteArray sub = QByteArray("hget ") + field;
+	QList<QByteArray> values;
+	if (cache_lookup(key, sub, values))
 	{
-		m_error = rr->error();
+		callback(values.first());
+		return;
 	}
 
-	return false;
+	quint64 since = cache_begin();
+	send({"hget", key, field}, [this, key, sub, since, callback](const redis_reply &rr)
+	{
+		QByteArray value = reply_bytes(rr);
+		cache_store(key, sub, since, rr, QList<QByteArray>() << value);
+		callback(value);
+	});
 }
 
-qlonglong QRedis::setrange(const QString &key, qlonglong offset, const QString &value)
+QStringList QRedis::hgetall(const QString &key)
 {
-	QList<QByteArray>temp;
-	temp.append("setrange");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(offset).toUtf8());
-	temp.append(value.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	return from_utf8(hgetallRaw(key.toUtf8()));
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::hgetall(const QString &key, const redis_string_list_callback &callback)
+{
+	hgetallRaw(key.toUtf8(), [callback](const QList<QByteArray> &value)
 	{
-		m_error = "read time out";
-		return 0;
-	}
+		callback(from_utf8(value));
+	});
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+QList<QByteArray> QRedis::hgetallRaw(const QByteArray &key)
+{
+	QList<QByteArray> values;
+	if (cache_lookup(key, "hgetall", values)) return values;
+
+	quint64 since = cache_begin();
+	redis_reply rr = execute({"hgetall", key});
+	values = reply_list(rr);
+	cache_store(key, "hgetall", since, rr, values);
+	return values;
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER )
+void QRedis::hgetallRaw(const QByteArray &key, const redis_bytes_list_callback &callback)
+{
+	QList<QByteArray> values;
+	if (cache_lookup(key, "hgetall", values))
 	{
-		return rr->integer();
+		callback(values);
+		return;
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+
+	quint64 since = cache_begin();
+	send({"hgetall", key}, [this, key, since, callback](const redis_reply &rr)
 	{
-		m_error = rr->error();
-	}
+		QList<QByteArray> values = reply_list(rr);
+		cache_store(key, "hgetall", since, rr, values);
+		callback(values);
+	});
+}
 
-	return 0;
+qlonglong QRedis::hincrby(const QString &key, const QString &field, qlonglong value)
+{
+	return execute(redis_commands::hincrby, key.toUtf8(), field.toUtf8(), value);
 }
 
-qlonglong QRedis::strlen(const QString &key)
+void QRedis::hincrby(const QString &key, const QString &field, qlonglong value, const redis_integer_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("strlen");
-	temp.append(key.toUtf8());
+	send(redis_commands::hincrby, callback, key.toUtf8(), field.toUtf8(), value);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+qreal QRedis::hincrbyfloat(const QString &key, const QString &field, qreal value)
+{
+	return execute(redis_commands::hincrbyfloat, key.toUtf8(), field.toUtf8(), QByteArray::number(value));
+}
+
+void QRedis::hincrbyfloat(const QString &key, const QString &field, qreal value, const redis_real_callback &callback)
+{
+	send(redis_commands::hincrbyfloat, callback, key.toUtf8(), field.toUtf8(), QByteArray::number(value));
+}
+
+QStringList QRedis::hkeys(const QString &key)
+{
+	return from_utf8(hkeysRaw(key.toUtf8()));
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::hkeys(const QString &key, const redis_string_list_callback &callback)
+{
+	hkeysRaw(key.toUtf8(), [callback](const QList<QByteArray> &value)
 	{
-		m_error = "read time out";
-		return 0;
-	}
+		callback(from_utf8(value));
+	});
+}
+
+QList<QByteArray> QRedis::hkeysRaw(const QByteArray &key)
+{
+	return execute(redis_commands::hkeys, key);
+}
+
+void QRedis::hkeysRaw(const QByteArray &key, const redis_bytes_list_callback &callback)
+{
+	send(redis_commands::hkeys, callback, key);
+}
+
+qlonglong QRedis::hlen(const QString &key)
+{
+	return execute(redis_commands::hlen, key.toUtf8());
+}
+
+void QRedis::hlen(const QString &key, const redis_integer_callback &callback)
+{
+	send(redis_commands::hlen, callback, key.toUtf8());
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+QStringList QRedis::hmget(const QString &key, const QStringList &fields)
+{
+	return from_utf8(hmgetRaw(key.toUtf8(), to_utf8(fields)));
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER )
+void QRedis::hmget(const QString &key, const QStringList &fields, const redis_string_list_callback &callback)
+{
+	hmgetRaw(key.toUtf8(), to_utf8(fields), [callback](const QList<QByteArray> &value)
 	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+		callback(from_utf8(value));
+	});
+}
+
+QList<QByteArray> QRedis::hmgetRaw(const QByteArray &key, const QList<QByteArray> &fields)
+{
+	return execute(redis_commands::hmget, key, fields);
+}
+
+void QRedis::hmgetRaw(const QByteArray &key, const QList<QByteArray> &fields, const redis_bytes_list_callback &callback)
+{
+	send(redis_commands::hmget, callback, key, fields);
+}
+
+bool QRedis::hmset(const QString &key, const QStringList &fvs)
+{
+	return hmsetRaw(key.toUtf8(), to_utf8(fvs));
+}
+
+void QRedis::hmset(const QString &key, const QStringList &fvs, const redis_bool_callback &callback)
+{
+	hmsetRaw(key.toUtf8(), to_utf8(fvs), callback);
+}
+
+bool QRedis::hmsetRaw(const QByteArray &key, const QList<QByteArray> &fvs)
+{
+	return execute(redis_commands::hmset, key, fvs);
+}
+
+void QRedis::hmsetRaw(const QByteArray &key, const QList<QByteArray> &fvs, const redis_bool_callback &callback)
+{
+	send(redis_commands::hmset, callback, key, fvs);
+}
+
+int QRedis::hset(const QString &key, const QString &field, const QString &value)
+{
+	return hsetRaw(key.toUtf8(), field.toUtf8(), value.toUtf8());
+}
+
+void QRedis::hset(const QString &key, const QString &field, const QString &value, const redis_integer_callback &callback)
+{
+	hsetRaw(key.toUtf8(), field.toUtf8(), value.toUtf8(), callback);
+}
+
+int QRedis::hsetRaw(const QByteArray &key, const QByteArray &field, const QByteArray &value)
+{
+	return execute(redis_commands::hset, key, field, value);
+}
+
+void QRedis::hsetRaw(const QByteArray &key, const QByteArray &field, const QByteArray &value, const redis_integer_callback &callback)
+{
+	send(redis_commands::hset, callback, key, field, value);
+}
+
+bool QRedis::hsetnx(const QString &key, const QString &field, const QString &value)
+{
+	return hsetnxRaw(key.toUtf8(), field.toUtf8(), value.toUtf8());
+}
+
+void QRedis::hsetnx(const QString &key, const QString &field, const QString &value, const redis_bool_callback &callback)
+{
+	hsetnxRaw(key.toUtf8(), field.toUtf8(), value.toUtf8(), callback);
+}
+
+bool QRedis::hsetnxRaw(const QByteArray &key, const QByteArray &field, const QByteArray &value)
+{
+	return execute(redis_commands::hsetnx, key, field, value);
+}
+
+void QRedis::hsetnxRaw(const QByteArray &key, const QByteArray &field, const QByteArray &value, const redis_bool_callback &callback)
+{
+	send(redis_commands::hsetnx, callback, key, field, value);
+}
+
+QStringList QRedis::hvals(const QString &key)
+{
+	return from_utf8(hvalsRaw(key.toUtf8()));
+}
+
+void QRedis::hvals(const QString &key, const redis_string_list_callback &callback)
+{
+	hvalsRaw(key.toUtf8(), [callback](const QList<QByteArray> &value)
 	{
-		m_error = rr->error();
-	}
+		callback(from_utf8(value));
+	});
+}
 
-	return 0;
+QList<QByteArray> QRedis::hvalsRaw(const QByteArray &key)
+{
+	return execute(redis_commands::hvals, key);
 }
 
-qlonglong QRedis::hdel(const QString &key, const QString &field)
+void QRedis::hvalsRaw(const QByteArray &key, const redis_bytes_list_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("hdel");
-	temp.append(key.toUtf8());
-	temp.append(field.toUtf8());
+	send(redis_commands::hvals, callback, key);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+QString QRedis::lindex(const QString &key, qlonglong index)
+{
+	return from_utf8(lindexRaw(key.toUtf8(), index));
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::lindex(const QString &key, qlonglong index, const redis_string_callback &callback)
+{
+	lindexRaw(key.toUtf8(), index, [callback](const QByteArray &value)
 	{
-		m_error = "read time out";
-		return 0;
-	}
+		callback(from_utf8(value));
+	});
+}
+
+QByteArray QRedis::lindexRaw(const QByteArray &key, qlonglong index)
+{
+	return execute(redis_commands::lindex, key, index);
+}
+
+void QRedis::lindexRaw(const QByteArray &key, qlonglong index, const redis_bytes_callback &callback)
+{
+	send(redis_commands::lindex, callback, key, index);
+}
+
+qlonglong QRedis::llen(const QString &key)
+{
+	return execute(redis_commands::llen, key.toUtf8());
+}
+
+void QRedis::llen(const QString &key, const redis_integer_callback &callback)
+{
+	send(redis_commands::llen, callback, key.toUtf8());
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+QString QRedis::lpop(const QString &key)
+{
+	return from_utf8(lpopRaw(key.toUtf8()));
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER )
+void QRedis::lpop(const QString &key, const redis_string_callback &callback)
+{
+	lpopRaw(key.toUtf8(), [callback](const QByteArray &value)
 	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+		callback(from_utf8(value));
+	});
+}
+
+QByteArray QRedis::lpopRaw(const QByteArray &key)
+{
+	return execute(redis_commands::lpop, key);
+}
+
+void QRedis::lpopRaw(const QByteArray &key, const redis_bytes_callback &callback)
+{
+	send(redis_commands::lpop, callback, key);
+}
+
+qlonglong QRedis::lpush(const QString &key, const QString &value)
+{
+	return lpushRaw(key.toUtf8(), value.toUtf8());
+}
+
+void QRedis::lpush(const QString &key, const QString &value, const redis_integer_callback &callback)
+{
+	lpushRaw(key.toUtf8(), value.toUtf8(), callback);
+}
+
+qlonglong QRedis::lpushRaw(const QByteArray &key, const QByteArray &value)
+{
+	return execute(redis_commands::lpush, key, value);
+}
+
+void QRedis::lpushRaw(const QByteArray &key, const QByteArray &value, const redis_integer_callback &callback)
+{
+	send(redis_commands::lpush, callback, key, value);
+}
+
+qlonglong QRedis::lpush(const QString &key, const QStringList &values)
+{
+	return lpushRaw(key.toUtf8(), to_utf8(values));
+}
+
+void QRedis::lpush(const QString &key, const QStringList &values, const redis_integer_callback &callback)
+{
+	lpushRaw(key.toUtf8(), to_utf8(values), callback);
+}
+
+qlonglong QRedis::lpushRaw(const QByteArray &key, const QList<QByteArray> &values)
+{
+	return execute(redis_commands::lpush, key, values);
+}
+
+void QRedis::lpushRaw(const QByteArray &key, const QList<QByteArray> &values, const redis_integer_callback &callback)
+{
+	send(redis_commands::lpush, callback, key, values);
+}
+
+QStringList QRedis::lrange(const QString &key, qlonglong start, qlonglong stop)
+{
+	return from_utf8(lrangeRaw(key.toUtf8(), start, stop));
+}
+
+void QRedis::lrange(const QString &key, qlonglong start, qlonglong stop, const redis_string_list_callback &callback)
+{
+	lrangeRaw(key.toUtf8(), start, stop, [callback](const QList<QByteArray> &value)
 	{
-		m_error = rr->error();
-	}
+		callback(from_utf8(value));
+	});
+}
+
+QList<QByteArray> QRedis::lrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop)
+{
+	return execute(redis_commands::lrange, key, start, stop);
+}
+
+void QRedis::lrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop, const redis_bytes_list_callback &callback)
+{
+	send(redis_commands::lrange, callback, key, start, stop);
+}
+
+qlonglong QRedis::lrem(const QString &key, int count, const QString &value)
+{
+	return lremRaw(key.toUtf8(), count, value.toUtf8());
+}
+
+void QRedis::lrem(const QString &key, int count, const QString &value, const redis_integer_callback &callback)
+{
+	lremRaw(key.toUtf8(), count, value.toUtf8(), callback);
+}
+
+qlonglong QRedis::lremRaw(const QByteArray &key, int count, const QByteArray &value)
+{
+	return execute(redis_commands::lrem, key, count, value);
+}
+
+void QRedis::lremRaw(const QByteArray &key, int count, const QByteArray &value, const redis_integer_callback &callback)
+{
+	send(redis_commands::lrem, callback, key, count, value);
+}
+
+bool QRedis::lset(const QString &key, int index, const QString &value)
+{
+	return lsetRaw(key.toUtf8(), index, value.toUtf8());
+}
+
+void QRedis::lset(const QString &key, int index, const QString &value, const redis_bool_callback &callback)
+{
+	lsetRaw(key.toUtf8(), index, value.toUtf8(), callback);
+}
+
+bool QRedis::lsetRaw(const QByteArray &key, int index, const QByteArray &value)
+{
+	return execute(redis_commands::lset, key, index, value);
+}
 
-	return 0;
+void QRedis::lsetRaw(const QByteArray &key, int index, const QByteArray &value, const redis_bool_callback &callback)
+{
+	send(redis_commands::lset, callback, key, index, value);
 }
 
-qlonglong QRedis::hdel(const QString &key, const QStringList &fields)
+QString QRedis::rpop(const QString &key)
+{
+	return from_utf8(rpopRaw(key.toUtf8()));
+}
+
+void QRedis::rpop(const QString &key, const redis_string_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("hdel");
-	temp.append(key.toUtf8());
-	foreach(QString field, fields)
+	rpopRaw(key.toUtf8(), [callback](const QByteArray &value)
 	{
-		temp.append(field.toUtf8());
-	}
+		callback(from_utf8(value));
+	});
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+QByteArray QRedis::rpopRaw(const QByteArray &key)
+{
+	return execute(redis_commands::rpop, key);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
-	}
+void QRedis::rpopRaw(const QByteArray &key, const redis_bytes_callback &callback)
+{
+	send(redis_commands::rpop, callback, key);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+qlonglong QRedis::rpush(const QString &key, const QString &value)
+{
+	return rpushRaw(key.toUtf8(), value.toUtf8());
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER )
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::rpush(const QString &key, const QString &value, const redis_integer_callback &callback)
+{
+	rpushRaw(key.toUtf8(), value.toUtf8(), callback);
+}
 
-	return 0;
+qlonglong QRedis::rpushRaw(const QByteArray &key, const QByteArray &value)
+{
+	return execute(redis_commands::rpush, key, value);
 }
 
-bool QRedis::hexists(const QString &key)
+void QRedis::rpushRaw(const QByteArray &key, const QByteArray &value, const redis_integer_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("hexists");
-	temp.append(key.toUtf8());
+	send(redis_commands::rpush, callback, key, value);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+qlonglong QRedis::rpush(const QString &key, const QStringList &values)
+{
+	return rpushRaw(key.toUtf8(), to_utf8(values));
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return false;
-	}
+void QRedis::rpush(const QString &key, const QStringList &values, const redis_integer_callback &callback)
+{
+	rpushRaw(key.toUtf8(), to_utf8(values), callback);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+qlonglong QRedis::rpushRaw(const QByteArray &key, const QList<QByteArray> &values)
+{
+	return execute(redis_commands::rpush, key, values);
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER )
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::rpushRaw(const QByteArray &key, const QList<QByteArray> &values, const redis_integer_callback &callback)
+{
+	send(redis_commands::rpush, callback, key, values);
+}
 
-	return 0;
+qlonglong QRedis::sadd(const QString &key, const QString &value)
+{
+	return saddRaw(key.toUtf8(), value.toUtf8());
 }
 
-QString QRedis::hget(const QString &key, const QString &field)
+void QRedis::sadd(const QString &key, const QString &value, const redis_integer_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("hget");
-	temp.append(key.toUtf8());
-	temp.append(field.toUtf8());
+	saddRaw(key.toUtf8(), value.toUtf8(), callback);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+qlonglong QRedis::saddRaw(const QByteArray &key, const QByteArray &value)
+{
+	return execute(redis_commands::sadd, key, value);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return "";
-	}
+void QRedis::saddRaw(const QByteArray &key, const QByteArray &value, const redis_integer_callback &callback)
+{
+	send(redis_commands::sadd, callback, key, value);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+qlonglong QRedis::sadd(const QString &key, const QStringList &values)
+{
+	return saddRaw(key.toUtf8(), to_utf8(values));
+}
 
-	if (rr->type() == REDIS_RESULT_STRING)
-	{
-		return rr->string();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::sadd(const QString &key, const QStringList &values, const redis_integer_callback &callback)
+{
+	saddRaw(key.toUtf8(), to_utf8(values), callback);
+}
 
-	return "";
+qlonglong QRedis::saddRaw(const QByteArray &key, const QList<QByteArray> &values)
+{
+	return execute(redis_commands::sadd, key, values);
 }
 
-QStringList QRedis::hgetall(const QString &key)
+void QRedis::saddRaw(const QByteArray &key, const QList<QByteArray> &values, const redis_integer_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("hgetall");
-	temp.append(key.toUtf8());
+	send(redis_commands::sadd, callback, key, values);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+qlonglong QRedis::scard(const QString &key)
+{
+	return execute(redis_commands::scard, key.toUtf8());
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return QStringList();
-	}
+void QRedis::scard(const QString &key, const redis_integer_callback &callback)
+{
+	send(redis_commands::scard, callback, key.toUtf8());
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+QStringList QRedis::sdiff(const QStringList &keys)
+{
+	return from_utf8(sdiffRaw(to_utf8(keys)));
+}
 
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
-	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
-		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
-		}
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::sdiff(const QStringList &keys, const redis_string_list_callback &callback)
+{
+	sdiffRaw(to_utf8(keys), [callback](const QList<QByteArray> &value)
 	{
-		m_error = rr->error();
-	}
+		callback(from_utf8(value));
+	});
+}
 
-	return data;
+QList<QByteArray> QRedis::sdiffRaw(const QList<QByteArray> &keys)
+{
+	return execute(redis_commands::sdiff, keys);
 }
 
-qlonglong QRedis::hincrby(const QString &key, const QString &field, qlonglong value)
+void QRedis::sdiffRaw(const QList<QByteArray> &keys, const redis_bytes_list_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("hincrby");
-	temp.append(key.toUtf8());
-	temp.append(field.toUtf8());
-	temp.append(QString::number(value).toUtf8());
+	send(redis_commands::sdiff, callback, keys);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+QStringList QRedis::sinter(const QStringList &keys)
+{
+	return from_utf8(sinterRaw(to_utf8(keys)));
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::sinter(const QStringList &keys, const redis_string_list_callback &callback)
+{
+	sinterRaw(to_utf8(keys), [callback](const QList<QByteArray> &value)
 	{
-		m_error = "read time out";
-		return -9999;
-	}
+		callback(from_utf8(value));
+	});
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+QList<QByteArray> QRedis::sinterRaw(const QList<QByteArray> &keys)
+{
+	return execute(redis_commands::sinter, keys);
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::sinterRaw(const QList<QByteArray> &keys, const redis_bytes_list_callback &callback)
+{
+	send(redis_commands::sinter, callback, keys);
+}
 
-	return -9999;
+bool QRedis::sismember(const QString &key, const QString &value)
+{
+	return sismemberRaw(key.toUtf8(), value.toUtf8());
 }
 
-qreal QRedis::hincrbyfloat(const QString &key, const QString &field, qreal value)
+void QRedis::sismember(const QString &key, const QString &value, const redis_bool_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("hincrbyfloat");
-	temp.append(key.toUtf8());
-	temp.append(field.toUtf8());
-	temp.append(QString::number(value).toUtf8());
+	sismemberRaw(key.toUtf8(), value.toUtf8(), callback);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+bool QRedis::sismemberRaw(const QByteArray &key, const QByteArray &value)
+{
+	return execute(redis_commands::sismember, key, value);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0.0;
-	}
+void QRedis::sismemberRaw(const QByteArray &key, const QByteArray &value, const redis_bool_callback &callback)
+{
+	send(redis_commands::sismember, callback, key, value);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+QStringList QRedis::smembers(const QString &key)
+{
+	return from_utf8(smembersRaw(key.toUtf8()));
+}
 
-	if (rr->type() == REDIS_RESULT_STRING)
-	{
-		return rr->string().toDouble();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::smembers(const QString &key, const redis_string_list_callback &callback)
+{
+	smembersRaw(key.toUtf8(), [callback](const QList<QByteArray> &value)
 	{
-		m_error = rr->error();
-	}
-
-	return 0.0;
+		callback(from_utf8(value));
+	});
 }
 
-QStringList QRedis::hkeys(const QString &key)
+QList<QByteArray> QRedis::smembersRaw(const QByteArray &key)
 {
-	QList<QByteArray>temp;
-	temp.append("hkeys");
-	temp.append(key.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	return execute(redis_commands::smembers, key);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return QStringList();
-	}
+void QRedis::smembersRaw(const QByteArray &key, const redis_bytes_list_callback &callback)
+{
+	send(redis_commands::smembers, callback, key);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+qlonglong QRedis::srem(const QString &key, const QString &value)
+{
+	return sremRaw(key.toUtf8(), value.toUtf8());
+}
 
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
-	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
-		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
-		}
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::srem(const QString &key, const QString &value, const redis_integer_callback &callback)
+{
+	sremRaw(key.toUtf8(), value.toUtf8(), callback);
+}
 
-	return data;
+qlonglong QRedis::sremRaw(const QByteArray &key, const QByteArray &value)
+{
+	return execute(redis_commands::srem, key, value);
 }
 
-qlonglong QRedis::hlen(const QString &key)
+void QRedis::sremRaw(const QByteArray &key, const QByteArray &value, const redis_integer_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("hlen");
-	temp.append(key.toUtf8());
+	send(redis_commands::srem, callback, key, value);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+qlonglong QRedis::srem(const QString &key, const QStringList &values)
+{
+	return sremRaw(key.toUtf8(), to_utf8(values));
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return -9999;
-	}
+void QRedis::srem(const QString &key, const QStringList &values, const redis_integer_callback &callback)
+{
+	sremRaw(key.toUtf8(), to_utf8(values), callback);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+qlonglong QRedis::sremRaw(const QByteArray &key, const QList<QByteArray> &values)
+{
+	return execute(redis_commands::srem, key, values);
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::sremRaw(const QByteArray &key, const QList<QByteArray> &values, const redis_integer_callback &callback)
+{
+	send(redis_commands::srem, callback, key, values);
+}
 
-	return -9999;
+QStringList QRedis::sunion(const QStringList &keys)
+{
+	return from_utf8(sunionRaw(to_utf8(keys)));
 }
 
-QStringList QRedis::hmget(const QString &key, const QStringList &fields)
+void QRedis::sunion(const QStringList &keys, const redis_string_list_callback &callback)
 {
-	QList<QByteArray>temp;
-	temp.append("hmget");
-	temp.append(key.toUtf8());
-	foreach(QString field, fields)
+	sunionRaw(to_utf8(keys), [callback](const QList<QByteArray> &value)
 	{
-		temp.append(field.toUtf8());
-	}
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+		callback(from_utf8(value));
+	});
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return QStringList();
-	}
+QList<QByteArray> QRedis::sunionRaw(const QList<QByteArray> &keys)
+{
+	return execute(redis_commands::sunion, keys);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+void QRedis::sunionRaw(const QList<QByteArray> &keys, const redis_bytes_list_callback &callback)
+{
+	send(redis_commands::sunion, callback, keys);
+}
 
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
-	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
-		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
-		}
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::psubscribe(const QString &pattern)
+{
+	m_pchannels.insert(pattern);
 
-	return data;
+	subscriber_send({"psubscribe", pattern.toUtf8()});
 }
 
-bool QRedis::hmset(const QString &key, const QStringList &fvs)
+void QRedis::psubscribe(const QStringList &patterns)
 {
-	QList<QByteArray> temp;
-	temp.append("hmset");
-	temp.append(key.toUtf8());
-	foreach(QString fv, fvs)
+	foreach(const QString &p, patterns)
 	{
-		temp.append(fv.toUtf8());
+		m_pchannels.insert(p);
 	}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	subscriber_send({"psubscribe"}, to_utf8(patterns));
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return false;
-	}
+int QRedis::publish(const QString &channel, const QString &data)
+{
+	return publishRaw(channel.toUtf8(), data.toUtf8());
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+void QRedis::publish(const QString &channel, const QString &data, const redis_integer_callback &callback)
+{
+	publishRaw(channel.toUtf8(), data.toUtf8(), callback);
+}
 
-	if (rr->type() == REDIS_RESULT_STATUS)
-	{
-		if (rr->string() == "OK") return true;
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+int QRedis::publishRaw(const QByteArray &channel, const QByteArray &data)
+{
+	return execute(redis_commands::publish, channel, data);
+}
 
-	return false;
+void QRedis::publishRaw(const QByteArray &channel, const QByteArray &data, const redis_integer_callback &callback)
+{
+	send(redis_commands::publish, callback, channel, data);
 }
 
-int QRedis::hset(const QString &key, const QString &field, const QString &value)
+void QRedis::punsubscribe()
 {
-	QList<QByteArray> temp;
-	temp.append("hset");
-	temp.append(key.toUtf8());
-	temp.append(field.toUtf8());
-	temp.append(value.toUtf8());
+	m_pchannels.clear();
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	subscriber_send({"punsubscribe"});
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return -1;
-	}
+void QRedis::punsubscribe(const QString &pattern)
+{
+	m_pchannels.remove(pattern);
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	subscriber_send({"punsubscribe", pattern.toUtf8()});
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::punsubscribe(const QStringList &patterns)
+{
+	foreach(const QString &p, patterns)
 	{
-		m_error = rr->error();
+		m_pchannels.remove(p);
 	}
 
-	return -1;
+	subscriber_send({"punsubscribe"}, to_utf8(patterns));
 }
 
-bool QRedis::hsetnx(const QString &key, const QString &field, const QString &value)
+void QRedis::subscribe(const QString &channel)
 {
-	QList<QByteArray> temp;
-	temp.append("hsetnx");
-	temp.append(key.toUtf8());
-	temp.append(field.toUtf8());
-	temp.append(value.toUtf8());
+	m_channels.insert(channel);
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	subscriber_send({"subscribe", channel.toUtf8()});
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::subscribe(const QStringList &channels)
+{
+	foreach(const QString &c, channels)
 	{
-		m_error = "read time out";
-		return false;
+		m_channels.insert(c);
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	subscriber_send({"subscribe"}, to_utf8(channels));
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::unsubscribe()
+{
+	if (m_cache.isEnabled() && m_protocol < 3)
 	{
-		m_error = rr->error();
+		// keep the invalidation channel of the cache
+		if (!m_channels.isEmpty()) unsubscribe(QStringList(m_channels.values()));
+		return;
 	}
 
-	return false;
+	m_channels.clear();
+
+	subscriber_send({"unsubscribe"});
 }
 
-QStringList QRedis::hvals(const QString &key)
+void QRedis::unsubscribe(const QString &channel)
 {
-	QList<QByteArray>temp;
-	temp.append("hvals");
-	temp.append(key.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return QStringList();
-	}
+	m_channels.remove(channel);
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	subscriber_send({"unsubscribe", channel.toUtf8()});
+}
 
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
-	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
-		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
-		}
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::unsubscribe(const QStringList &channels)
+{
+	foreach(const QString &c, channels)
 	{
-		m_error = rr->error();
+		m_channels.remove(c);
 	}
 
-	return data;
+	subscriber_send({"unsubscribe"}, to_utf8(channels));
 }
 
-QString QRedis::lindex(const QString &key, qlonglong index)
+bool QRedis::watch(const QString &key)
 {
-	QList<QByteArray> temp;
-	temp.append("lindex");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(index).toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	return execute(redis_commands::watch, key.toUtf8());
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return "";
-	}
+void QRedis::watch(const QString &key, const redis_bool_callback &callback)
+{
+	send(redis_commands::watch, callback, key.toUtf8());
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+bool QRedis::watch(const QStringList &keys)
+{
+	return watchRaw(to_utf8(keys));
+}
 
-	if (rr->type() == REDIS_RESULT_STRING)
-	{
-		return rr->string();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::watch(const QStringList &keys, const redis_bool_callback &callback)
+{
+	watchRaw(to_utf8(keys), callback);
+}
 
-	return "";
+bool QRedis::watchRaw(const QList<QByteArray> &keys)
+{
+	return execute(redis_commands::watch, keys);
 }
 
-qlonglong QRedis::llen(const QString &key)
+void QRedis::watchRaw(const QList<QByteArray> &keys, const redis_bool_callback &callback)
 {
-	QList<QByteArray> temp;
-	temp.append("llen");
-	temp.append(key.toUtf8());
+	send(redis_commands::watch, callback, keys);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+bool QRedis::unwatch()
+{
+	return execute(redis_commands::unwatch);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
-	}
+void QRedis::unwatch(const redis_bool_callback &callback)
+{
+	send(redis_commands::unwatch, callback);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+QRedisScript::QRedisScript(const QString &source) : m_source(source.toUtf8())
+{
+	m_sha1 = QCryptographicHash::hash(m_source, QCryptographicHash::Sha1).toHex();
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+QStringList QRedis::eval(const QString &script, const QStringList &args)
+{
+	return eval(QRedisScript(script), args);
+}
 
-	return 0;
+void QRedis::eval(const QString &script, const QStringList &args, const redis_string_list_callback &callback)
+{
+	eval(QRedisScript(script), args, callback);
 }
 
-QString QRedis::lpop(const QString &key)
+static bool is_noscript(const redis_reply &rr)
 {
-	QList<QByteArray> temp;
-	temp.append("lpop");
-	temp.append(key.toUtf8());
+	return rr.type() == REDIS_RESULT_ERROR && rr.error().startsWith("NOSCRIPT");
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+QStringList QRedis::eval(const QRedisScript &script, const QStringList &args)
+{
+	return reply_script(evalRaw(script, to_utf8(args)));
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::eval(const QRedisScript &script, const QStringList &args, const redis_string_list_callback &callback)
+{
+	evalRaw(script, to_utf8(args), [this, callback](const redis_reply &rr)
 	{
-		m_error = "read time out";
-		return "";
-	}
+		callback(reply_script(rr));
+	});
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+redis_reply QRedis::evalRaw(const QRedisScript &script, const QList<QByteArray> &args)
+{
+	// one deadline for the whole call; the retry gets what is left of it
+	int msecs = take_timeout();
+	QElapsedTimer timer;
+	timer.start();
+	redis_reply rr = withTimeout(msecs).execute({"evalsha", script.sha1()}, args);
+	if (!is_noscript(rr)) return rr;
+
+	// loaded and run in one round trip
+	send({"script", "load", script.source()}, [this](const redis_reply &rr)
+	{
+		reply_check(rr);
+	});
+	int remaining = msecs < 0 ? -1 : qMax(0, msecs - int(timer.elapsed()));
+	return withTimeout(remaining).execute({"evalsha", script.sha1()}, args);
+}
 
-	if (rr->type() == REDIS_RESULT_STRING)
-	{
-		return rr->string();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+void QRedis::evalRaw(const QRedisScript &script, const QList<QByteArray> &args, const redis_callback &callback)
+{
+	send({"evalsha", script.sha1()}, args, [this, script, args, callback](const redis_reply &rr)
 	{
-		m_error = rr->error();
-	}
+		if (!is_noscript(rr))
+		{
+			callback(rr);
+			return;
+		}
 
-	return "";
+		// commands sent meanwhile are answered before the retry, so their
+		// callbacks wait for it
+		QSharedPointer<redis_hold> hold = hold_pending();
+		send({"script", "load", script.source()}, [this](const redis_reply &rr)
+		{
+			reply_check(rr);
+		});
+		send({"evalsha", script.sha1()}, args, [hold, callback](const redis_reply &rr)
+		{
+			callback(rr);
+			release_held(hold.data());
+		});
+	});
 }
 
-qlonglong QRedis::lpush(const QString &key, const QString &value)
+QSharedPointer<redis_hold> QRedis::hold_pending()
 {
-	QList<QByteArray> temp;
-	temp.append("lpush");
-	temp.append(key.toUtf8());
-	temp.append(value.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	QSharedPointer<redis_hold> hold(new redis_hold);
+	for (int i = 0; i < m_pending.count(); i++)
+	{
+		redis_callback callback = m_pending[i].callback;
+		m_pending[i].callback = [hold, callback](const redis_reply &rr)
+		{
+			if (hold->released)
+			{
+				callback(rr);
+				return;
+			}
+			hold->replies.append(qMakePair(callback, rr));
+		};
+	}
+	return hold;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::release_held(redis_hold *hold)
+{
+	hold->released = true;
+	while (!hold->replies.isEmpty())
 	{
-		m_error = "read time out";
-		return 0;
+		QPair<redis_callback, redis_reply> held = hold->replies.takeFirst();
+		held.first(held.second);
 	}
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+void QRedis::registerScript(const QRedisScript &script)
+{
+	m_registered.append(script);
+	if (!m_sock || !m_sock->isConnected()) return;
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	send({"script", "load", script.source()}, [this](const redis_reply &rr)
 	{
-		m_error = rr->error();
-	}
+		reply_check(rr);
+	});
+}
 
-	return 0;
+QStringList QRedis::evalsha(const QString &sha1, const QStringList &args)
+{
+	return reply_script(evalshaRaw(sha1.toUtf8(), to_utf8(args)));
 }
 
-qlonglong QRedis::lpush(const QString &key, const QStringList &values)
+void QRedis::evalsha(const QString &sha1, const QStringList &args, const redis_string_list_callback &callback)
 {
-	QList<QByteArray> temp;
-	temp.append("lpush");
-	temp.append(key.toUtf8());
-	foreach(QString value, values)
+	evalshaRaw(sha1.toUtf8(), to_utf8(args), [this, callback](const redis_reply &rr)
 	{
-		temp.append(value.toUtf8());
-	}
+		callback(reply_script(rr));
+	});
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+redis_reply QRedis::evalshaRaw(const QByteArray &sha1, const QList<QByteArray> &args)
+{
+	return execute({"evalsha", sha1}, args);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
-	}
+void QRedis::evalshaRaw(const QByteArray &sha1, const QList<QByteArray> &args, const redis_callback &callback)
+{
+	send({"evalsha", sha1}, args, callback);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+bool QRedis::scriptexists(const QString &sha1)
+{
+	return execute(redis_commands::script_exists, sha1.toUtf8());
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::scriptexists(const QString &sha1, const redis_bool_callback &callback)
+{
+	send(redis_commands::script_exists, callback, sha1.toUtf8());
+}
 
-	return 0;
+QStringList QRedis::scriptexists(const QStringList &sha1s)
+{
+	return execute(redis_commands::script_exists_all, to_utf8(sha1s));
 }
 
-QStringList QRedis::lrange(const QString &key, qlonglong start, qlonglong stop)
+void QRedis::scriptexists(const QStringList &sha1s, const redis_string_list_callback &callback)
 {
-	QList<QByteArray> temp;
-	temp.append("lrange");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(start).toUtf8());
-	temp.append(QString::number(stop).toUtf8());
+	send(redis_commands::script_exists_all, callback, to_utf8(sha1s));
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+void QRedis::scriptflush()
+{
+	execute(redis_commands::script_flush);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return QStringList();
-	}
+void QRedis::scriptflush(const redis_done_callback &callback)
+{
+	send(redis_commands::script_flush, callback);
+}
 
-	QStringList data;
-	redis_reply *rr = get_redis_object(m_sock);
-	if (!rr) return data;
+void QRedis::scriptkill()
+{
+	execute(redis_commands::script_kill);
+}
 
-	if (rr->type() == REDIS_RESULT_ARRAY)
-	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
-		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
-		}
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::scriptkill(const redis_done_callback &callback)
+{
+	send(redis_commands::script_kill, callback);
+}
 
-	return data;
+QString QRedis::scriptload(const QString &script)
+{
+	return execute(redis_commands::script_load, script.toUtf8());
 }
 
-qlonglong QRedis::lrem(const QString &key, int count, const QString &value)
+void QRedis::scriptload(const QString &script, const redis_string_callback &callback)
 {
-	QList<QByteArray> temp;
-	temp.append("lrem");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(count).toLocal8Bit());
-	temp.append(value.toUtf8());
+	send(redis_commands::script_load, callback, script.toUtf8());
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+bool QRedis::auth(const QString &pw)
+{
+	m_password = pw.toUtf8();
+	return execute(redis_commands::auth, pw.toUtf8());
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
-	}
+void QRedis::auth(const QString &pw, const redis_bool_callback &callback)
+{
+	m_password = pw.toUtf8();
+	send(redis_commands::auth, callback, pw.toUtf8());
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+bool QRedis::ping()
+{
+	return execute(redis_commands::ping);
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::ping(const redis_bool_callback &callback)
+{
+	send(redis_commands::ping, callback);
+}
 
-	return 0;
+void QRedis::quit()
+{
+	execute(redis_commands::quit);
 }
 
-bool QRedis::lset(const QString &key, int index, const QString &value)
+void QRedis::quit(const redis_done_callback &callback)
 {
-	QList<QByteArray> temp;
-	temp.append("lset");
-	temp.append(key.toUtf8());
-	temp.append(QString::number(index).toUtf8());
-	temp.append(value.toLocal8Bit());
+	send(redis_commands::quit, callback);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+bool QRedis::select(int db)
+{
+	// tracking goes by key name, not by database
+	m_db = db;
+	m_cache.clear();
+	return execute(redis_commands::select, db);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return false;
-	}
+void QRedis::select(int db, const redis_bool_callback &callback)
+{
+	m_db = db;
+	m_cache.clear();
+	send(redis_commands::select, callback, db);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+bool QRedis::hello(int protover)
+{
+	return reply_hello(execute({"hello", protover}), protover);
+}
 
-	if (rr->type() == REDIS_RESULT_STRING)
+void QRedis::hello(int protover, const redis_bool_callback &callback)
+{
+	send({"hello", protover}, [this, protover, callback](const redis_reply &rr)
 	{
-		if (rr->string() == "OK") return true;
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+		callback(reply_hello(rr, protover));
+	});
+}
+
+int QRedis::protocol() const
+{
+	return m_protocol;
+}
+
+void QRedis::enableCache(int budget, const QStringList &prefixes)
+{
+	bool tracking = m_cache.isEnabled();
+	m_cache.setBudget(budget);
+	m_cache.setPrefixes(to_utf8(prefixes));
+	m_cache.clear();
+	m_cacheactive = false;
+	if (!m_sock || !m_cache.isEnabled() || !m_sock->isConnected()) return;
+
+	// tracking options cannot be changed while it is on
+	if (tracking)
 	{
-		m_error = rr->error();
+		send({"client", "tracking", "off"}, [this](const redis_reply &rr)
+		{
+			reply_check(rr);
+		});
 	}
 
-	return false;
+	// a subscribed connection cannot ask for its id, so it is reopened
+	if (m_protocol < 3 && m_subsid < 0 && m_subssock->isConnected()) m_subssock->close();
+	cache_track();
 }
 
-QString QRedis::rpop(const QString &key)
+void QRedis::disableCache()
 {
-	QList<QByteArray> temp;
-	temp.append("rpop");
-	temp.append(key.toUtf8());
+	if (!m_cache.isEnabled()) return;
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	m_cache.setBudget(0);
+	m_cacheactive = false;
+	if (!m_sock || !m_sock->isConnected()) return;
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	send({"client", "tracking", "off"}, [this](const redis_reply &rr)
 	{
-		m_error = "read time out";
-		return "";
-	}
+		reply_check(rr);
+	});
+	if (m_protocol < 3) subscriber_send({"unsubscribe", "__redis__:invalidate"});
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+qlonglong QRedis::cacheHits() const
+{
+	return m_cache.hits();
+}
 
-	if (rr->type() == REDIS_RESULT_STRING)
-	{
-		return rr->string();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+qlonglong QRedis::cacheMisses() const
+{
+	return m_cache.misses();
+}
 
-	return "";
+bool QRedis::bgsave()
+{
+	return execute(redis_commands::bgsave);
 }
 
-qlonglong QRedis::rpush(const QString &key, const QString &value)
+void QRedis::bgsave(const redis_bool_callback &callback)
 {
-	QList<QByteArray> temp;
-	temp.append("rpush");
-	temp.append(key.toUtf8());
-	temp.append(value.toUtf8());
+	send(redis_commands::bgsave, callback);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+QString QRedis::clientgetname()
+{
+	return execute(redis_commands::client_getname);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
-	}
+void QRedis::clientgetname(const redis_string_callback &callback)
+{
+	send(redis_commands::client_getname, callback);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+bool QRedis::clientkill(const QString &ipport)
+{
+	return execute(redis_commands::client_kill, ipport.toUtf8());
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::clientkill(const QString &ipport, const redis_bool_callback &callback)
+{
+	send(redis_commands::client_kill, callback, ipport.toUtf8());
+}
 
-	return 0;
+QStringList QRedis::clientlist()
+{
+	return execute(redis_commands::client_list);
 }
 
-qlonglong QRedis::rpush(const QString &key, const QStringList &values)
+void QRedis::clientlist(const redis_string_list_callback &callback)
 {
-	QList<QByteArray> temp;
-	temp.append("rpush");
-	temp.append(key.toUtf8());
-	foreach(QString value, values)
-	{
-		temp.append(value.toUtf8());
-	}
+	send(redis_commands::client_list, callback);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+bool QRedis::clientsetname(const QString &name)
+{
+	m_clientname = name.toUtf8();
+	return execute(redis_commands::client_setname, name.toUtf8());
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
-	}
+void QRedis::clientsetname(const QString &name, const redis_bool_callback &callback)
+{
+	m_clientname = name.toUtf8();
+	send(redis_commands::client_setname, callback, name.toUtf8());
+}
+
+qlonglong QRedis::dbsize()
+{
+	return execute(redis_commands::dbsize);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+void QRedis::dbsize(const redis_integer_callback &callback)
+{
+	send(redis_commands::dbsize, callback);
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::flushall()
+{
+	execute(redis_commands::flushall);
+}
 
-	return 0;
+void QRedis::flushall(const redis_done_callback &callback)
+{
+	send(redis_commands::flushall, callback);
 }
 
-qlonglong QRedis::sadd(const QString &key, const QString &value)
+void QRedis::flushdb()
 {
-	QList<QByteArray> temp;
-	temp.append("sadd");
-	temp.append(key.toUtf8());
-	temp.append(value.toUtf8());
+	execute(redis_commands::flushdb);
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+void QRedis::flushdb(const redis_done_callback &callback)
+{
+	send(redis_commands::flushdb, callback);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
-	}
+QString QRedis::info()
+{
+	return execute(redis_commands::info);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+void QRedis::info(const redis_string_callback &callback)
+{
+	send(redis_commands::info, callback);
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+QDateTime QRedis::time()
+{
+	return execute(redis_commands::time);
+}
 
-	return 0;
+void QRedis::time(const redis_time_callback &callback)
+{
+	send(redis_commands::time, callback);
 }
 
-qlonglong QRedis::sadd(const QString &key, const QStringList &values)
+void QRedis::readyRead()
 {
-	QList<QByteArray> temp;
-	temp.append("sadd");
-	temp.append(key.toUtf8());
-	foreach(QString value, values)
+	// cache_drain() reads the socket itself
+	if (m_draining) return;
+
+	m_replydepth++;
+	// frames read ahead by cache_drain() come first
+	while (!m_subsdeferred.isEmpty())
 	{
-		temp.append(value.toUtf8());
+		subscriber_reply(m_subsdeferred.dequeue());
 	}
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	m_subsparser.feed(m_subssock->readAll());
+	while (m_subsparser.hasReply())
 	{
-		m_error = "read time out";
-		return 0;
+		subscriber_reply(m_subsparser.takeReply());
 	}
+	m_replydepth--;
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_INTEGER)
+	if (m_subsparser.hasError())
 	{
-		return rr->integer();
+		qWarning() << "protocol error on subscribe connection";
+		m_subsparser.reset();
+		m_subssock->close();
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+}
+
+void QRedis::subscriber_reply(const redis_reply &rr)
+{
+	// pub/sub traffic comes as arrays, anything else answers the requests
+	// sent by connected(), in the order they were sent
+	if (rr.type() != REDIS_RESULT_ARRAY && !m_subsrequests.isEmpty())
 	{
-		m_error = rr->error();
+		QByteArray request = m_subsrequests.dequeue();
+		if (rr.type() == REDIS_RESULT_ERROR)
+		{
+			qWarning() << request << "failed on subscribe connection:" << rr.error();
+		}
+		else if (request == "client id" && rr.type() == REDIS_RESULT_INTEGER)
+		{
+			// the redirect target of the cache tracking
+			m_subsid = rr.integer();
+			if (m_sock->isConnected()) send_tracking(m_subsid);
+		}
+		return;
 	}
+	dispatch_message(rr);
+}
 
-	return 0;
+bool QRedis::uses_subscriber() const
+{
+	// under RESP3 subscriptions and invalidations live on the command connection
+	return m_protocol < 3 && (!m_channels.isEmpty() || !m_pchannels.isEmpty() || m_cache.isEnabled());
 }
 
-qlonglong QRedis::scard(const QString &key)
+bool QRedis::dispatch_message(const redis_reply &rr)
 {
-	QList<QByteArray> temp;
-	temp.append("scard");
-	temp.append(key.toUtf8());
+	if (rr.type() != REDIS_RESULT_ARRAY && rr.type() != REDIS_RESULT_PUSH) return false;
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	// message: [kind, channel, data], pmessage: [kind, pattern, channel, data],
+	// invalidate: [kind, keys]
+	int count = rr.count();
+	if (count < 2) return false;
+
+	if (invalidation_message(rr)) return true;
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	QString kind = rr.at(0).string();
+	if ((kind == "message" && count == 3) || (kind == "pmessage" && count == 4))
 	{
-		m_error = "read time out";
-		return 0;
+		QByteArray channel = rr.at(count - 2).bytes();
+		QByteArray data = rr.at(count - 1).bytes();
+		emit subscribeRaw(channel, data);
+		emit subscribe(from_utf8(channel), from_utf8(data));
+		return true;
 	}
+	return false;
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+bool QRedis::invalidation_message(const redis_reply &rr)
+{
+	if (rr.type() != REDIS_RESULT_ARRAY && rr.type() != REDIS_RESULT_PUSH) return false;
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
+	int count = rr.count();
+	QByteArray kind = count > 0 ? rr.at(0).bytes() : QByteArray();
+	if (kind == "invalidate" && count == 2)
 	{
-		return rr->integer();
+		cache_invalidate(rr.at(1));
+		return true;
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	if (kind == "message" && count == 3 && rr.at(1).bytes() == "__redis__:invalidate")
 	{
-		m_error = rr->error();
+		cache_invalidate(rr.at(2));
+		return true;
 	}
-
-	return 0;
+	return false;
 }
 
-QStringList QRedis::sdiff(const QStringList &keys)
+void QRedis::subscriber_send(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args)
 {
-	QList<QByteArray> temp;
-	temp.append("sdiff");
-	foreach(QString key, keys)
+	if (m_protocol >= 3)
 	{
-		temp.append(key.toUtf8());
+		// confirmations and messages come back as push frames, not as replies
+		if (!m_sock || !m_sock->isConnected()) return;
+		m_writer.append(cmd, args);
+		m_batchcount++;
+		flushPending();
+		return;
 	}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	if (!m_subssock) return;
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	// the subscriber connection only exists while something is subscribed
+	if (!uses_subscriber())
 	{
-		m_error = "read time out";
-		return QStringList();
+		m_subssock->close();
+		return;
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
-	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
-		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
-		}
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	// channels are recorded by the caller and replayed once connected
+	if (!m_subssock->isConnected())
 	{
-		m_error = rr->error();
+		if (!m_subssock->isConnecting()) m_subssock->open();
+		return;
 	}
 
-	return data;
+	m_subswriter.clear();
+	m_subswriter.append(cmd, args);
+	m_subswriter.writeTo(m_subssock);
+	m_subssock->flush();
 }
 
-QStringList QRedis::sinter(const QStringList &keys)
+/*
+ * Result slot of a synchronous call. It is shared with the pending callback
+ * so that a reply arriving after the caller gave up has somewhere to go.
+ */
+struct redis_sync_reply
 {
-	QList<QByteArray> temp;
-	temp.append("sinter");
-	foreach(QString key, keys)
-	{
-		temp.append(key.toUtf8());
-	}
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	redis_sync_reply() : done(false) {}
+	bool done;
+	redis_reply reply;
+};
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+redis_reply QRedis::execute(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args, const redis_stream &stream)
+{
+	// a blocking call fails fast instead of waiting for a reconnect
+	if (!m_sock || !m_sock->isConnected())
 	{
-		m_error = "read time out";
-		return QStringList();
+		m_hasnexttimeout = false;
+		m_error = "not connected";
+		return redis_reply::fromError(m_error);
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
-	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
-		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
-		}
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	QSharedPointer<redis_sync_reply> sync(new redis_sync_reply);
+	send(cmd, args, [sync](const redis_reply &rr)
 	{
-		m_error = rr->error();
-	}
+		sync->done = true;
+		sync->reply = rr;
+	}, stream);
+	flushPending();
 
-	return data;
+	if (!wait_for([sync] { return sync->done; })) return redis_reply();
+	return sync->reply;
 }
 
-bool QRedis::sismember(const QString &key, const QString &value)
+bool QRedis::wait_for(const std::function<bool ()> &done)
 {
-	QList<QByteArray> temp;
-	temp.append("sismember");
-	temp.append(key.toUtf8());
-	temp.append(value.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	int msecs = take_timeout();
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	// one deadline for the whole reply, however many reads it takes; with
+	// none left the socket is still polled, so a timeout of 0 takes what
+	// has already arrived
+	QElapsedTimer timer;
+	timer.start();
+	while (!done())
 	{
-		m_error = "read time out";
-		return false;
+		int remaining = msecs < 0 ? -1 : qMax(0, msecs - int(timer.elapsed()));
+		if ((msecs >= 0 && timer.elapsed() > msecs) || !m_sock->waitForReadyRead(remaining))
+		{
+			m_error = "read time out";
+			return false;
+		}
+
+		// readyRead is not re-emitted when we are already inside replyRead()
+		replyRead();
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	return true;
+}
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+void QRedis::setTimeout(int msecs)
+{
+	m_timeout = msecs;
+}
 
-	return false;
+int QRedis::timeout() const
+{
+	return m_timeout;
 }
 
-QStringList QRedis::smembers(const QString &key)
+QRedis &QRedis::withTimeout(int msecs)
 {
-	QList<QByteArray> temp;
-	temp.append("smembers");
-	temp.append(key.toUtf8());
+	m_nexttimeout = msecs;
+	m_hasnexttimeout = true;
+	return *this;
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+int QRedis::take_timeout()
+{
+	int msecs = m_hasnexttimeout ? m_nexttimeout : m_timeout;
+	m_hasnexttimeout = false;
+	return msecs;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return QStringList();
-	}
+void QRedis::send(std::initializer_list<redis_arg> cmd, const redis_callback &callback)
+{
+	send(cmd, QList<QByteArray>(), callback);
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+/*
+ * Read-only commands that can safely be sent again when their connection
+ * was lost before the reply arrived.
+ */
+static bool is_idempotent(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args)
+{
+	static const QSet<QByteArray> reads = QSet<QByteArray>()
+		<< "get" << "mget" << "getrange" << "strlen" << "exists" << "type" << "ttl" << "pttl"
+		<< "keys" << "dump" << "hget" << "hmget" << "hgetall" << "hkeys" << "hvals" << "hlen"
+		<< "hexists" << "lindex" << "llen" << "lrange" << "scard" << "smembers" << "sismember"
+		<< "srandmember" << "sinter" << "sunion" << "sdiff" << "dbsize" << "echo" << "ping"
+		<< "time" << "info";
 
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
+	QByteArray name;
+	if (cmd.size() > 0)
 	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
-		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
-		}
+		name = QByteArray(cmd.begin()->data(), cmd.begin()->size());
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else if (!args.isEmpty())
 	{
-		m_error = rr->error();
+		name = args.first();
 	}
-
-	return data;
+	return reads.contains(name.toLower());
 }
 
-qlonglong QRedis::srem(const QString &key, const QString &value)
+void QRedis::cache_written(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args)
 {
-	QList<QByteArray> temp;
-	temp.append("srem");
-	temp.append(key.toUtf8());
-	temp.append(value.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
-	}
+	// under RESP2 the invalidation for our own write comes on the subscriber
+	// connection, possibly after the reply; any argument may be a key
+	if (m_protocol >= 3 || !m_cache.isEnabled() || is_idempotent(cmd, args)) return;
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_INTEGER)
+	bool name = true;
+	foreach (const redis_arg &arg, cmd)
 	{
-		return rr->integer();
+		if (!name) m_cache.invalidate(QByteArray::fromRawData(arg.data(), arg.size()));
+		name = false;
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	foreach (const QByteArray &arg, args)
 	{
-		m_error = rr->error();
+		if (!name) m_cache.invalidate(arg);
+		name = false;
 	}
-
-	return 0;
 }
 
-qlonglong QRedis::srem(const QString &key, const QStringList &values)
+void QRedis::send(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args, const redis_callback &callback, const redis_stream &stream)
 {
-	QList<QByteArray> temp;
-	temp.append("srem");
-	temp.append(key.toUtf8());
-	foreach(QString value, values)
+	cache_written(cmd, args);
+	if (!m_sock || !m_sock->isConnected())
 	{
-		temp.append(value.toUtf8());
-	}
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+		if (!m_sock || m_offline.count() >= m_offlinelimit)
+		{
+			callback(redis_reply::fromError("not connected"));
+			return;
+		}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
+		// held until the reconnect, see connected()
+		redis_writer writer;
+		writer.append(cmd, args);
+		m_offline.enqueue(redis_pending(callback, writer.toByteArray(), is_idempotent(cmd, args), stream));
+		return;
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	int start = m_writer.size();
+	m_writer.append(cmd, args);
+	// a streamed reply may already be partly handed out, so it is never resent
+	bool idempotent = stream.isNull() && is_idempotent(cmd, args);
+	redis_pending pending(callback, (idempotent && m_readretries > 0) ? m_writer.toByteArray(start) : QByteArray(), idempotent, stream);
+	pending.offset = start;
+	m_pending.enqueue(pending);
+	m_batchcount++;
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
+	if (m_batchcount >= m_maxbatchcount || m_writer.size() >= m_maxbatchbytes)
 	{
-		return rr->integer();
+		flushPending();
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else if (!m_flushtimer->isActive())
 	{
-		m_error = rr->error();
+		// everything issued before we get back to the event loop goes out in one write
+		m_flushtimer->start(0);
 	}
-
-	return 0;
 }
 
-QStringList QRedis::sunion(const QStringList &keys)
+void QRedis::send_batch(const redis_writer &batch, int count, const redis_callback &callback)
 {
-	QList<QByteArray> temp;
-	temp.append("sunion");
-	foreach(QString key, keys)
-	{
-		temp.append(key.toUtf8());
-	}
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return QStringList();
-	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
+	if (!m_sock || !m_sock->isConnected())
 	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
+		redis_reply rr = redis_reply::fromError("not connected");
+		for (int i = 0; i < count; i++)
 		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
+			callback(rr);
 		}
+		return;
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+
+	// anything coalesced so far was issued first and must be answered first
+	flushPending();
+	for (int i = 0; i < count; i++)
 	{
-		m_error = rr->error();
+		m_pending.enqueue(redis_pending(callback));
 	}
-
-	return data;
+	batch.writeTo(m_sock);
+	m_sock->flush();
 }
 
-void QRedis::psubscribe(const QString &pattern)
+void QRedis::flushPending()
 {
-	QList<QByteArray> temp;
-	temp.append("psubscribe");
-	temp.append(pattern.toUtf8());
-	m_pchannels.insert(pattern);
+	m_flushtimer->stop();
+	if (m_batchcount == 0) return;
 
-	QByteArray res = format(temp);
-	m_subssock->write(res);
-	m_subssock->flush();
+	m_writer.writeTo(m_sock);
+	m_sock->flush();
+	m_writer.clear();
+	m_batchcount = 0;
 }
 
-void QRedis::psubscribe(const QStringList &patterns)
+void QRedis::setMaxBatch(int commands, int bytes)
 {
-	QList<QByteArray> temp;
-	temp.append("psubscribe");
-	foreach(QString p, patterns)
-	{
-		temp.append(p.toUtf8());
-		m_pchannels.insert(p);
-	}
-
-	QByteArray res = format(temp);
-	m_subssock->write(res);
-	m_subssock->flush();
+	m_maxbatchcount = commands;
+	m_maxbatchbytes = bytes;
 }
 
-int QRedis::publish(const QString &channel, const QString &data)
+void QRedis::replyRead()
 {
-	QList<QByteArray> temp;
-	temp.append("publish");
-	temp.append(channel.toUtf8());
-	temp.append(data.toUtf8());
+	// cache_drain() reads the socket itself
+	if (m_draining) return;
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return 0;
-	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	m_replydepth++;
+	// frames read ahead by cache_drain() come first
+	while (!m_deferred.isEmpty())
 	{
-		m_error = rr->error();
+		redis_reply rr = m_deferred.dequeue();
+		if (!dispatch_message(rr)) emit push(rr);
 	}
 
-	return 0;
-}
-
-void QRedis::punsubscribe()
-{
-	QList<QByteArray> temp;
-	temp.append("punsubscribe");
+	// replies are parsed one by one, so the head is always the command being answered
+	m_parser.setStream(m_pending.isEmpty() ? redis_stream() : m_pending.head().stream);
+	m_parser.feed(m_sock->readAll());
 
-	QByteArray res = format(temp);
-	m_subssock->write(res);
-	m_subssock->flush();
-
-	m_pchannels.clear();
-}
+	forever
+	{
+		m_parser.setStream(m_pending.isEmpty() ? redis_stream() : m_pending.head().stream);
+		if (!m_parser.hasReply()) break;
 
-void QRedis::punsubscribe(const QString &pattern)
-{
-	QList<QByteArray> temp;
-	temp.append("punsubscribe");
-	temp.append(pattern.toUtf8());
+		redis_reply rr = m_parser.takeReply();
+		if (rr.type() == REDIS_RESULT_PUSH)
+		{
+			// out-of-band, it answers no command
+			if (!dispatch_message(rr)) emit push(rr);
+			continue;
+		}
+		if (m_pending.isEmpty())
+		{
+			qWarning() << "reply without a pending command";
+			continue;
+		}
 
-	QByteArray res = format(temp);
-	m_subssock->write(res);
-	m_subssock->flush();
+		redis_callback callback = m_pending.dequeue().callback;
+		callback(rr);
+	}
+	m_replydepth--;
 
-	m_pchannels.remove(pattern);
+	if (m_parser.hasError())
+	{
+		m_parser.reset();
+		fail_pending("protocol error");
+		m_sock->close();
+	}
 }
 
-void QRedis::punsubscribe(const QStringList &patterns)
+void QRedis::fail_pending(const QString &error)
 {
-	QList<QByteArray> temp;
-	temp.append("punsubscribe");
-	foreach(QString p, patterns)
+	redis_reply rr = redis_reply::fromError(error);
+	while (!m_pending.isEmpty())
 	{
-		temp.append(p.toUtf8());
-		m_pchannels.remove(p);
+		redis_callback callback = m_pending.dequeue().callback;
+		callback(rr);
 	}
-
-	QByteArray res = format(temp);
-	m_subssock->write(res);
-	m_subssock->flush();
 }
 
-void QRedis::subscribe(const QString &channel)
+void QRedis::schedule_reconnect()
 {
-	QList<QByteArray> temp;
-	temp.append("subscribe");
-	temp.append(channel.toUtf8());
-	m_channels.insert(channel);
-
-	QByteArray res = format(temp);
-	m_subssock->write(res);
-	m_subssock->flush();
-}
+	if (m_reconnecttimer->isActive()) return;
 
-void QRedis::subscribe(const QStringList &channels)
-{
-	QList<QByteArray> temp;
-	temp.append("subscribe");
-	foreach(QString c, channels)
+	// exponential backoff with jitter, so a restarted server is not hit by every client at once
+	int delay = m_reconnectbase;
+	for (int i = 0; i < m_attempt && delay < m_reconnectmax; i++)
 	{
-		temp.append(c.toUtf8());
-		m_channels.insert(c);
+		delay *= 2;
 	}
+	delay = qMin(delay, m_reconnectmax);
+	delay = delay / 2 + QRandomGenerator::global()->bounded(delay / 2 + 1);
 
-	QByteArray res = format(temp);
-	m_subssock->write(res);
-	m_subssock->flush();
+	m_reconnecttimer->start(delay);
 }
 
-void QRedis::unsubscribe()
+void QRedis::stop_timers()
 {
-	QList<QByteArray> temp;
-	temp.append("unsubscribe");
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	m_channels.clear();
+	// for a connection about to lose its thread, which could not run them
+	flushPending();
+	m_reconnecttimer->stop();
+	m_deferredtimer->stop();
 }
 
-void QRedis::unsubscribe(const QString &channel)
+void QRedis::replay_session()
 {
-	QList<QByteArray> temp;
-	temp.append("unsubscribe");
-	temp.append(channel.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	m_channels.remove(channel);
-}
+	redis_callback check = [this](const redis_reply &rr)
+	{
+		reply_check(rr);
+	};
 
-void QRedis::unsubscribe(const QStringList &channels)
-{
-	QList<QByteArray> temp;
-	temp.append("unsubscribe");
-	foreach(QString c, channels)
+	if (!m_password.isEmpty()) send({"auth", m_password}, check);
+	if (m_protocol != 2) send({"hello", m_protocol}, check);
+	if (m_db != 0) send({"select", m_db}, check);
+	if (!m_clientname.isEmpty()) send({"client", "setname", m_clientname}, check);
+	foreach (const QRedisScript &script, m_registered)
 	{
-		temp.append(c.toUtf8());
-		m_channels.remove(c);
+		send({"script", "load", script.source()}, check);
 	}
-
-	QByteArray res = format(temp);
-	m_subssock->write(res);
-	m_subssock->flush();
+	cache_track();
 }
 
-QStringList QRedis::eval(const QString &script, const QStringList &args)
+void QRedis::reply_check(const redis_reply &rr)
 {
-	QList<QByteArray> temp;
-	temp.append("eval");
-	temp.append(script.toUtf8());
-	foreach(QString arg, args)
+	if (rr.type() == REDIS_RESULT_ERROR)
 	{
-		temp.append(arg.toUtf8());
+		m_error = rr.error();
 	}
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+bool QRedis::reply_hello(const redis_reply &rr, int protover)
+{
+	if (rr.type() != REDIS_RESULT_MAP && rr.type() != REDIS_RESULT_ARRAY)
 	{
-		m_error = "read time out";
-		return QStringList();
+		reply_check(rr);
+		return false;
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
+	bool moved = protover >= 3 && uses_subscriber();
+	bool retrack = m_cache.isEnabled() && protover != m_protocol;
+	m_protocol = protover;
+	if (moved)
 	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
-		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
-		}
+		// the subscriptions move over to the command connection
+		m_subsparser.reset();
+		m_subssock->close();
+		resubscribe();
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	if (retrack)
 	{
-		m_error = rr->error();
+		// invalidations now arrive on the other connection
+		m_cacheactive = false;
+		m_cache.clear();
+		cache_track();
 	}
-
-	return data;
+	return true;
 }
 
-QStringList QRedis::evalsha(const QString &sha1, const QStringList &args)
+bool QRedis::cache_ready()
 {
-	QList<QByteArray> temp;
-	temp.append("evalsha");
-	temp.append(sha1.toUtf8());
-	foreach(QString arg, args)
-	{
-		temp.append(arg.toUtf8());
-	}
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return QStringList();
-	}
+	// a hit must not overtake replies still owed to earlier commands
+	if (!m_cacheactive || !m_pending.isEmpty() || m_batchcount > 0 || !m_offline.isEmpty()) return false;
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	// a handler further up the stack has taken in everything read so far
+	if (m_replydepth == 0) cache_drain();
+	return m_cacheactive;
+}
 
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
-	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
+void QRedis::cache_drain()
+{
+	// takes in invalidations that arrived since the event loop last ran
+	bool resp3 = m_protocol >= 3;
+	QRedisTransport *sock = resp3 ? m_sock : m_subssock;
+	if (!sock->isConnected()) return;
+
+	// read here rather than in the slots, which would run callbacks and
+	// emit messages from inside the lookup
+	m_draining = true;
+	sock->waitForReadyRead(0);
+	QByteArray data = sock->isConnected() ? sock->readAll() : QByteArray();
+	m_draining = false;
+	if (data.isEmpty()) return;
+
+	redis_parser &parser = resp3 ? m_parser : m_subsparser;
+	parser.feed(data);
+	while (parser.hasReply())
+	{
+		redis_reply rr = parser.takeReply();
+		if (invalidation_message(rr)) continue;
+
+		// nothing is pending here, so any other frame is out-of-band and
+		// is handed out from the event loop
+		if (!resp3)
+		{
+			m_subsdeferred.enqueue(rr);
+		}
+		else if (rr.type() == REDIS_RESULT_PUSH)
 		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
+			m_deferred.enqueue(rr);
+		}
+		else
+		{
+			qWarning() << "reply without a pending command";
 		}
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	if (!m_deferred.isEmpty() || !m_subsdeferred.isEmpty()) m_deferredtimer->start(0);
+
+	if (parser.hasError())
 	{
-		m_error = rr->error();
+		qWarning() << "protocol error while reading invalidations";
+		parser.reset();
+		sock->close();
 	}
-
-	return data;
 }
 
-bool QRedis::scriptexists(const QString &sha1)
+void QRedis::dispatchDeferred()
 {
-	QList<QByteArray> temp;
-	temp.append("script");
-	temp.append("exists");
-	temp.append(sha1.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return false;
-	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_INTEGER)
+	m_replydepth++;
+	while (!m_subsdeferred.isEmpty())
 	{
-		return rr->integer();
+		subscriber_reply(m_subsdeferred.dequeue());
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	while (!m_deferred.isEmpty())
 	{
-		m_error = rr->error();
+		redis_reply rr = m_deferred.dequeue();
+		if (!dispatch_message(rr)) emit push(rr);
 	}
-
-	return false;
+	m_replydepth--;
 }
 
-QStringList QRedis::scriptexists(const QStringList &sha1s)
+bool QRedis::cache_lookup(const QByteArray &key, const QByteArray &sub, QList<QByteArray> &values)
 {
-	QList<QByteArray> temp;
-	temp.append("script");
-	temp.append("exists");
-	foreach(QString arg, sha1s)
-	{
-		temp.append(arg.toLocal8Bit());
-	}
+	if (!m_cache.isCacheable(key) || !cache_ready()) return false;
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	const QList<QByteArray> *cached = m_cache.find(key, sub);
+	m_cache.record(cached != 0);
+	if (!cached) return false;
+	values = *cached;
+	return true;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+bool QRedis::cache_lookup(const QList<QByteArray> &keys, QList<QByteArray> &values)
+{
+	if (keys.isEmpty()) return false;
+	foreach (const QByteArray &key, keys)
 	{
-		m_error = "read time out";
-		return QStringList();
+		if (!m_cache.isCacheable(key)) return false;
 	}
+	if (!cache_ready()) return false;
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
+	// all or nothing, a partial hit still costs the round trip
+	values.clear();
+	foreach (const QByteArray &key, keys)
 	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
+		const QList<QByteArray> *cached = m_cache.find(key, "get");
+		if (!cached)
 		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
+			m_cache.record(false);
+			return false;
 		}
+		values.append(cached->first());
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
-
-	return data;
+	m_cache.record(true);
+	return true;
 }
 
-void QRedis::scriptflush()
+quint64 QRedis::cache_begin()
 {
-	QList<QByteArray> temp;
-	temp.append("script");
-	temp.append("flush");
-
-	QByteArray res = format(temp);
-	m_subssock->write(res);
-	m_subssock->flush();
+	return m_cacheactive ? m_cache.begin() : 0;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::cache_store(const QByteArray &key, const QByteArray &sub, quint64 since, const redis_reply &rr, const QList<QByteArray> &values)
+{
+	if (rr.type() != REDIS_RESULT_ERROR && rr.type() != REDIS_RESULT_UNKOWN)
 	{
-		m_error = "read time out";
-		return;
+		m_cache.store(key, sub, since, values);
 	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	m_cache.end(since);
 }
 
-void QRedis::scriptkill()
+void QRedis::cache_store(const QList<QByteArray> &keys, quint64 since, const redis_reply &rr, const QList<QByteArray> &values)
 {
-	QList<QByteArray> temp;
-	temp.append("script");
-	temp.append("kill");
-
-	QByteArray res = format(temp);
-	m_subssock->write(res);
-	m_subssock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	if (rr.type() != REDIS_RESULT_ERROR && rr.type() != REDIS_RESULT_UNKOWN && values.count() == keys.count())
 	{
-		m_error = "read time out";
-		return;
+		for (int i = 0; i < keys.count(); i++)
+		{
+			m_cache.store(keys[i], "get", since, QList<QByteArray>() << values[i]);
+		}
 	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	m_cache.end(since);
 }
 
-QString QRedis::scriptload(const QString &script)
+void QRedis::cache_track()
 {
-	QList<QByteArray> temp;
-	temp.append("script");
-	temp.append("load");
-	temp.append(script.toLocal8Bit());
+	if (!m_cache.isEnabled()) return;
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	if (m_protocol >= 3)
 	{
-		m_error = "read time out";
-		return "";
+		send_tracking(-1);
 	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_STRING)
+	else if (m_subsid >= 0)
 	{
-		return rr->string();
+		send_tracking(m_subsid);
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else if (!m_subssock->isConnected() && !m_subssock->isConnecting())
 	{
-		m_error = rr->error();
+		// tracking is turned on once the subscriber connection reported its id, see readyRead()
+		m_subssock->open();
 	}
-
-	return "";
 }
 
-bool QRedis::auth(const QString &pw)
+void QRedis::send_tracking(qlonglong redirect)
 {
-	QList<QByteArray> temp;
-	temp.append("auth");
-	temp.append(pw.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	QList<QByteArray> args;
+	if (redirect >= 0) args << "redirect" << QByteArray::number(redirect);
+	if (!m_cache.prefixes().isEmpty())
 	{
-		m_error = "read time out";
-		return false;
+		args << "bcast";
+		foreach (const QByteArray &prefix, m_cache.prefixes())
+		{
+			args << "prefix" << prefix;
+		}
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_STATUS)
-	{
-		if (rr->string() == "OK") return true;
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	m_cacheactive = false;
+	send({"client", "tracking", "on"}, args, [this](const redis_reply &rr)
 	{
-		m_error = rr->error();
-	}
-
-	return false;
+		reply_check(rr);
+		m_cacheactive = m_cache.isEnabled() && rr.type() == REDIS_RESULT_STATUS;
+	});
 }
 
-bool QRedis::ping()
+void QRedis::cache_invalidate(const redis_reply &keys)
 {
-	QList<QByteArray> temp;
-	temp.append("ping");
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	// a null key list is sent for flushall and flushdb
+	if (keys.type() == REDIS_RESULT_NIL)
 	{
-		m_error = "read time out";
-		return false;
+		m_cache.clear();
 	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_STRING)
+	else if (keys.type() == REDIS_RESULT_STRING)
 	{
-		if (rr->string() == "PONG") return true;
+		m_cache.invalidate(keys.bytes());
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else
 	{
-		m_error = rr->error();
+		for (int i = 0; i < keys.count(); i++)
+		{
+			m_cache.invalidate(keys.at(i).bytes());
+		}
 	}
-
-	return false;
 }
 
-void QRedis::quit()
+bool QRedis::reply_as(const redis_as_status &, const redis_reply &rr)
 {
-	QList<QByteArray> temp;
-	temp.append("quit");
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	// any status, for commands that do not answer OK
+	reply_check(rr);
+	return rr.type() == REDIS_RESULT_STATUS;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+QStringList QRedis::reply_as(const redis_as_lines &, const redis_reply &rr)
+{
+	// one bulk string, a line per entry
+	QStringList lines;
+	foreach (const QString &line, reply_string(rr).split('\n'))
 	{
-		m_error = "read time out";
-		return;
+		if (!line.isEmpty()) lines << line;
 	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	return lines;
 }
 
-bool QRedis::select(int db)
+redis_callback QRedis::decoder(const redis_as_done &, const redis_done_callback &callback)
 {
-	QList<QByteArray> temp;
-	temp.append("select");
-	temp.append(QString::number(db).toLocal8Bit());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	return [this, callback](const redis_reply &rr)
+	{
+		reply_check(rr);
+		callback();
+	};
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+bool QRedis::reply_bool(const redis_reply &rr)
+{
+	if (rr.type() == REDIS_RESULT_INTEGER)
 	{
-		m_error = "read time out";
-		return false;
+		return rr.integer() != 0;
 	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_STATUS)
+	else if (rr.type() == REDIS_RESULT_BOOLEAN)
 	{
-		if (rr->string() == "OK") return true;
+		return rr.boolean();
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else if (rr.type() == REDIS_RESULT_STATUS)
 	{
-		m_error = rr->error();
+		return rr.status() == "OK";
+	}
+	else if (rr.type() == REDIS_RESULT_ERROR)
+	{
+		m_error = rr.error();
 	}
 
 	return false;
 }
 
-bool QRedis::bgsave()
+qlonglong QRedis::reply_integer(const redis_reply &rr, qlonglong def)
 {
-	QList<QByteArray> temp;
-	temp.append("dbsize");
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return false;
-	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_STATUS)
+	if (rr.type() == REDIS_RESULT_INTEGER)
 	{
-		if (rr->string() == "OK") return true;
+		return rr.integer();
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else if (rr.type() == REDIS_RESULT_ERROR)
 	{
-		m_error = rr->error();
+		m_error = rr.error();
 	}
 
-	return false;
+	return def;
 }
 
-QString QRedis::clientgetname()
+qreal QRedis::reply_real(const redis_reply &rr)
 {
-	QList<QByteArray> temp;
-	temp.append("client getname");
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	if (rr.type() == REDIS_RESULT_STRING)
 	{
-		m_error = "read time out";
-		return "";
+		return rr.string().toDouble();
 	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_STRING)
+	else if (rr.type() == REDIS_RESULT_DOUBLE)
 	{
-		return rr->string();
+		return rr.real();
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else if (rr.type() == REDIS_RESULT_ERROR)
 	{
-		m_error = rr->error();
+		m_error = rr.error();
 	}
 
-	return "";
+	return 0.0;
 }
 
-bool QRedis::clientkill(const QString &ipport)
+QString QRedis::reply_string(const redis_reply &rr)
 {
-	QList<QByteArray> temp;
-	temp.append("client kill");
-	temp.append(ipport.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	if (rr.type() == REDIS_RESULT_STRING)
 	{
-		m_error = "read time out";
-		return false;
+		return rr.string();
 	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_STATUS)
+	else if (rr.type() == REDIS_RESULT_STATUS)
 	{
-		if (rr->string() == "OK") return true;
+		return rr.status();
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else if (rr.type() == REDIS_RESULT_ERROR)
 	{
-		m_error = rr->error();
+		m_error = rr.error();
 	}
 
-	return false;
+	return "";
 }
 
-QStringList QRedis::clientlist()
+QStringList QRedis::reply_strings(const redis_reply &rr)
 {
-	QList<QByteArray> temp;
-	temp.append("client list");
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
-	{
-		m_error = "read time out";
-		return QStringList();
-	}
-
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
 	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
+	if (is_aggregate(rr.type()))
 	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
+		for (int i = 0; i < rr.count(); i++)
 		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
+			data << redis_value<QString>(rr.at(i));
 		}
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else if (rr.type() == REDIS_RESULT_ERROR)
 	{
-		m_error = rr->error();
+		m_error = rr.error();
 	}
 
 	return data;
 }
 
-bool QRedis::clientsetname(const QString &name)
+QStringList QRedis::reply_script(const redis_reply &rr)
 {
-	QList<QByteArray> temp;
-	temp.append("client setname");
-	temp.append(name.toUtf8());
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	// a script may just as well return a single value
+	QString value;
+	if (!rr.isAggregate() && rr.type() != REDIS_RESULT_NIL && redis_decode(rr, value)) return QStringList() << value;
+	return reply_strings(rr);
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+QByteArray QRedis::reply_bytes(const redis_reply &rr)
+{
+	if (rr.type() == REDIS_RESULT_STRING)
 	{
-		m_error = "read time out";
-		return false;
+		return rr.bytes();
+	}
+	else if (rr.type() == REDIS_RESULT_ERROR)
+	{
+		m_error = rr.error();
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	return QByteArray();
+}
 
-	if (rr->type() == REDIS_RESULT_STATUS)
+QList<QByteArray> QRedis::reply_list(const redis_reply &rr)
+{
+	QList<QByteArray> data;
+	if (is_aggregate(rr.type()))
 	{
-		if (rr->string() == "OK") return true;
+		for (int i = 0; i < rr.count(); i++)
+		{
+			data << rr.at(i).bytes();
+		}
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	else if (rr.type() == REDIS_RESULT_ERROR)
 	{
-		m_error = rr->error();
+		m_error = rr.error();
 	}
 
-	return false;
+	return data;
 }
 
-qlonglong QRedis::dbsize()
+QDateTime QRedis::reply_time(const redis_reply &rr)
 {
-	QList<QByteArray> temp;
-	temp.append("dbsize");
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	QStringList data = reply_strings(rr);
+	if (data.count() != 2) return QDateTime();
+	return QDateTime::fromTime_t(data[0].toUInt());
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+void QRedis::error()
+{
+	QRedisTransport *transport = qobject_cast<QRedisTransport *>(sender());
+	if (transport)
 	{
-		m_error = "read time out";
-		return 0;
+		qWarning() << "The following error occurred: " << transport->errorString();
+		if (!transport->isConnected() && !transport->isConnecting()) schedule_reconnect();
 	}
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+void QRedis::reconnect()
+{
+	if (!m_sock) return;
 
-	if (rr->type() == REDIS_RESULT_INTEGER)
-	{
-		return rr->integer();
-	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
-	{
-		m_error = rr->error();
-	}
+	m_attempt++;
+	if (!m_sock->isConnected() && !m_sock->isConnecting()) m_sock->open();
 
-	return 0;
+	bool subscribed = uses_subscriber();
+	if (subscribed && !m_subssock->isConnected() && !m_subssock->isConnecting()) m_subssock->open();
 }
 
-void QRedis::flushall()
+void QRedis::disconnected()
 {
-	QList<QByteArray> temp;
-	temp.append("flushall");
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
-
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	if (m_subssock == sender())
 	{
-		m_error = "read time out";
+		m_subsparser.reset();
+		m_subsid = -1;
+		m_subsrequests.clear();
+		if (m_protocol < 3)
+		{
+			// invalidations sent meanwhile are lost
+			m_cacheactive = false;
+			m_cache.clear();
+		}
+		if (uses_subscriber()) schedule_reconnect();
 		return;
 	}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	m_sock->close();
+	connection_lost();
+	schedule_reconnect();
 }
 
-void QRedis::flushdb()
+void QRedis::connection_lost()
 {
-	QList<QByteArray> temp;
-	temp.append("flushdb");
-
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+	m_cacheactive = false;
+	m_cache.clear();
+	m_parser.reset();
+
+	// the batch not written yet never reached the server and is sent again as it is
+	QQueue<redis_pending> unsent;
+	int written = m_pending.count() - m_batchcount;
+	if (m_batchcount > 0)
+	{
+		int base = m_pending.at(written).offset;
+		QByteArray batch = m_writer.toByteArray(base);
+		for (int i = written; i < m_pending.count(); i++)
+		{
+			redis_pending pending = m_pending.at(i);
+			int end = (i + 1 < m_pending.count()) ? m_pending.at(i + 1).offset : m_writer.size();
+			pending.command = batch.mid(pending.offset - base, end - pending.offset);
+			pending.offset = -1;
+			unsent.enqueue(pending);
+		}
+	}
+	m_writer.clear();
+	m_batchcount = 0;
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	// of what was written only idempotent reads are resent, anything else may have run
+	QQueue<redis_pending> retry;
+	redis_reply rr = redis_reply::fromError("connection lost");
+	for (int i = 0; i < written; i++)
 	{
-		m_error = "read time out";
-		return;
+		redis_pending pending = m_pending.at(i);
+		if (pending.idempotent && !pending.command.isEmpty() && pending.attempts < m_readretries)
+		{
+			pending.attempts++;
+			retry.enqueue(pending);
+		}
+		else
+		{
+			pending.callback(rr);
+		}
 	}
+	m_pending.clear();
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	// resent reads and the unwritten batch go ahead of the commands held meanwhile
+	retry.append(unsent);
+	retry.append(m_offline);
+	m_offline = retry;
 }
 
-QString QRedis::info()
+void QRedis::connected()
 {
-	QList<QByteArray> temp;
-	temp.append("info");
+	if (m_sock == sender())
+	{
+		m_attempt = 0;
+		replay_session();
+		if (m_protocol >= 3) resubscribe();
+		flushPending();
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+		while (!m_offline.isEmpty())
+		{
+			redis_pending pending = m_offline.dequeue();
+			m_sock->write(pending.command.constData(), pending.command.size());
+			// from here on it may run, so only a read can be sent once more
+			if (!pending.idempotent || m_readretries == 0) pending.command.clear();
+			m_pending.enqueue(pending);
+		}
+		m_sock->flush();
+		return;
+	}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+	m_subsrequests.clear();
+	if (!m_password.isEmpty())
 	{
-		m_error = "read time out";
-		return "";
+		subscriber_send({"auth", m_password});
+		m_subsrequests.enqueue("auth");
 	}
+	bool tracking = m_cache.isEnabled() && m_protocol < 3;
+	if (tracking)
+	{
+		subscriber_send({"client", "id"});
+		m_subsrequests.enqueue("client id");
+	}
+	resubscribe();
+	if (tracking) subscriber_send({"subscribe", "__redis__:invalidate"});
+}
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
-
-	if (rr->type() == REDIS_RESULT_STRING)
+void QRedis::resubscribe()
+{
+	foreach (const QString &value, m_channels)
 	{
-		return rr->string();
+		subscribe(value);
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+	foreach (const QString &value, m_pchannels)
 	{
-		m_error = rr->error();
+		psubscribe(value);
 	}
+}
+
+QRedisPipeline::QRedisPipeline(QRedis *redis) : m_redis(redis), m_count(0)
+{
 
-	return "";
 }
 
-QDateTime QRedis::time()
+void QRedisPipeline::add(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args)
+{
+	m_writer.append(cmd, args);
+	m_callbacks.append(redis_callback());
+	m_count++;
+}
+
+void QRedisPipeline::add(const QList<QByteArray> &cmd)
 {
-	QList<QByteArray> temp;
-	temp.append("time");
+	if (cmd.isEmpty()) return;
+	m_writer.append({}, cmd);
+	m_callbacks.append(redis_callback());
+	m_count++;
+}
 
-	QByteArray res = format(temp);
-	m_sock->write(res);
-	m_sock->flush();
+int QRedisPipeline::count() const
+{
+	return m_count;
+}
+
+void QRedisPipeline::clear()
+{
+	m_writer.clear();
+	m_callbacks.clear();
+	m_count = 0;
+}
 
-	bool ret = m_sock->waitForReadyRead(1000);
-	if (!ret)
+static void pipeline_reply(redis_pipeline_state *state, const redis_reply &rr)
+{
+	int index = state->replies.count();
+	if (rr.type() == REDIS_RESULT_ERROR)
 	{
-		m_error = "read time out";
-		return QDateTime();
+		state->errors.insert(index, rr.error());
 	}
+	state->replies << rr;
 
-	redis_reply *rr = get_redis_object(m_sock);
-	rr->deleteLater();
+	redis_callback callback = state->callbacks.value(index);
+	if (callback) callback(rr);
+}
 
-	QStringList data;
-	if (rr->type() == REDIS_RESULT_ARRAY)
+QSharedPointer<redis_pipeline_state> QRedisPipeline::start(const redis_pipeline_callback &callback)
+{
+	QSharedPointer<redis_pipeline_state> state(new redis_pipeline_state);
+	state->expected = m_count;
+	state->callbacks = m_callbacks;
+	m_state = state;
+
+	if (m_count == 0)
 	{
-		QObjectList childs = rr->children();
-		for (int i = 0; i < childs.count(); i++)
-		{
-			redis_reply *temp = qobject_cast<redis_reply *>(childs[i]);
-			data << temp->string();
-		}
+		if (callback) callback(state->replies);
+		return state;
 	}
-	else if (rr->type() == REDIS_RESULT_ERROR)
+
+	m_redis->send_batch(m_writer, m_count, [state, callback](const redis_reply &rr)
 	{
-		m_error = rr->error();
-	}
+		// the batch was already given up on by a timed out exec()
+		if (state->replies.count() == state->expected) return;
 
-	if (data.count() != 2 ) return QDateTime();
-	return QDateTime::fromTime_t(data[0].toUInt());
+		pipeline_reply(state.data(), rr);
+
+		if (state->replies.count() == state->expected && callback)
+		{
+			callback(state->replies);
+		}
+	});
+	clear();
+
+	return state;
 }
 
-void QRedis::readyRead()
+QList<redis_reply> QRedisPipeline::exec()
 {
-  	do 
-  	{
-  		redis_reply *rr = get_redis_object(m_subssock);
-  		if (rr->type() != REDIS_RESULT_ARRAY) return;
- 
- 		QObjectList childs = rr->children();
- 		if (childs.count() != 3)  return;
- 
- 		redis_reply *temp = qobject_cast<redis_reply *>(childs[0]);
-  
-  		if (temp->string() == "message" || temp->string() == "pmessage")
-  		{
- 			redis_reply *temp1 = qobject_cast<redis_reply *>(childs[1]);
- 			redis_reply *temp2 = qobject_cast<redis_reply *>(childs[2]);
- 
-  			emit subscribe(temp1->string(), temp2->string());
-  		}
-  	} while (m_subssock->bytesAvailable());	
-}
-
-QByteArray QRedis::format(const QList<QByteArray> &cmd)
-{
-    QByteArray result;
-    result.append(QString("*%1\r\n").arg(cmd.length()));
-
-    foreach(QByteArray part, cmd)
-    {
-        result.append("$");
-        result.append(QString::number(part.size()));
-        result.append("\r\n");
-        result.append(part);
-        result.append("\r\n");
-    }
-
-    return result;
-}
-
-redis_reply* QRedis::get_redis_object(QTcpSocket *sock)
-{
-	QByteArray ch = read(sock, 1);
-	if (ch.isEmpty()) return 0;
-
-	switch (ch.at(0))
-	{
- 	case '-':	// ERROR
- 		return get_redis_error(sock);
- 	case '+':	// STATUS
- 		return get_redis_status(sock);
- 	case ':':	// INTEGER
- 		return get_redis_integer(sock);
- 	case '$':	// STRING
- 		return get_redis_string(sock);
- 	case '*':	// ARRAY
- 		return get_redis_array(sock);
-	default:	// INVALID
-		return 0;
+	QSharedPointer<redis_pipeline_state> state = start(redis_pipeline_callback());
+	if (!m_redis->wait_for([state] { return state->replies.count() == state->expected; }))
+	{
+		redis_reply rr = redis_reply::fromError("read time out");
+		while (state->replies.count() < state->expected)
+		{
+			pipeline_reply(state.data(), rr);
+		}
 	}
+
+	return state->replies;
 }
 
-redis_reply* QRedis::get_redis_error(QTcpSocket *sock)
+void QRedisPipeline::exec(const redis_pipeline_callback &callback)
 {
-	QByteArray data = readLine(sock);
-	if (data.isEmpty()) return 0;
+	start(callback);
+}
 
-	redis_reply* rr = new redis_reply;
-	rr->setType(REDIS_RESULT_ERROR);
-	rr->setData(data);
+bool QRedisPipeline::hasErrors() const
+{
+	return m_state && !m_state->errors.isEmpty();
+}
 
-	return rr;
+QMap<int, QString> QRedisPipeline::errors() const
+{
+	if (!m_state) return QMap<int, QString>();
+	return m_state->errors;
 }
 
-redis_reply* QRedis::get_redis_integer(QTcpSocket *sock)
+QRedisTransaction::QRedisTransaction(QRedis *redis) : m_redis(redis), m_pipeline(redis)
 {
-	QByteArray data = readLine(sock);
-	if (data.isEmpty()) return 0;
+	m_pipeline.add({"multi"});
+}
 
-	redis_reply* rr = new redis_reply;
-	rr->setType(REDIS_RESULT_INTEGER);
-	rr->setData(data);
+void QRedisTransaction::add(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args)
+{
+	m_pipeline.add(cmd, args);
+	m_callbacks.append(redis_callback());
+}
 
-	return rr;
+void QRedisTransaction::add(const QList<QByteArray> &cmd)
+{
+	if (cmd.isEmpty()) return;
+	m_pipeline.add(cmd);
+	m_callbacks.append(redis_callback());
 }
 
-redis_reply* QRedis::get_redis_status(QTcpSocket *sock)
+int QRedisTransaction::count() const
 {
-	QByteArray data = readLine(sock);
-	if (data.isEmpty()) return 0;
+	return m_pipeline.count() - 1;
+}
 
-	redis_reply* rr = new redis_reply;
-	rr->setType(REDIS_RESULT_STATUS);
-	rr->setData(data);
+void QRedisTransaction::clear()
+{
+	m_pipeline.clear();
+	m_pipeline.add({"multi"});
+	m_callbacks.clear();
+}
 
-	return rr;
+void QRedisTransaction::fail(redis_transaction_state *state, const QString &message)
+{
+	redis_reply rr = redis_reply::fromError(message);
+	foreach(const redis_callback &callback, state->callbacks)
+	{
+		if (callback) callback(rr);
+	}
 }
 
-redis_reply* QRedis::get_redis_string(QTcpSocket *sock)
+void QRedisTransaction::decode(redis_transaction_state *state, const QList<redis_reply> &replies)
 {
-	QByteArray data = readLine(sock);
-	if (data.isEmpty()) return 0;
-	data.chop(2);
-	int len = data.toInt();
+	// MULTI, one QUEUED per command, then EXEC
+	redis_reply multi = replies.first();
+	redis_reply rr = replies.last();
+	if (multi.type() == REDIS_RESULT_ERROR)
+	{
+		state->error = multi.error();
+		fail(state, state->error);
+		return;
+	}
 
-	redis_reply* rr = new redis_reply;
-	rr->setType(REDIS_RESULT_STRING);
+	bool execabort = rr.type() == REDIS_RESULT_ERROR && rr.error().startsWith("EXECABORT");
+	if (rr.type() != REDIS_RESULT_ARRAY && rr.type() != REDIS_RESULT_NIL && !execabort)
+	{
+		// read time out or connection lost, the server may still have run EXEC
+		state->error = (rr.type() == REDIS_RESULT_ERROR) ? rr.error() : QString("unexpected EXEC reply");
+		fail(state, state->error);
+		return;
+	}
 
-	if (len == -1) 
+	for (int i = 1; i < replies.count() - 1; i++)
 	{
-		rr->setData("nil");
+		if (replies[i].type() == REDIS_RESULT_ERROR)
+		{
+			state->queueErrors.insert(i - 1, replies[i].error());
+		}
 	}
-	else
+
+	if (rr.type() != REDIS_RESULT_ARRAY)
 	{
-		QByteArray bulkdata = read(sock, len + 2);
-		bulkdata.chop(2);
-		rr->setData(QString::fromUtf8(bulkdata.data(), bulkdata.length()));
+		// null reply when a watched key changed, EXECABORT when a command was rejected
+		state->aborted = true;
+		fail(state, execabort ? rr.error() : QString("transaction aborted"));
+		return;
 	}
 
-	return rr;
+	for (int i = 0; i < rr.count(); i++)
+	{
+		redis_reply result = rr.at(i);
+		if (result.type() == REDIS_RESULT_ERROR)
+		{
+			state->errors.insert(i, result.error());
+		}
+		state->results << result;
+
+		redis_callback callback = state->callbacks.value(i);
+		if (callback) callback(result);
+	}
 }
 
-redis_reply* QRedis::get_redis_array(QTcpSocket *sock)
+QSharedPointer<redis_transaction_state> QRedisTransaction::start()
 {
-	QByteArray data = readLine(sock);
-	if (data.isEmpty()) return 0;
-	data.chop(2);
-	int count = data.toInt();
-
-	redis_reply* rr = new redis_reply;
-	rr->setType(REDIS_RESULT_ARRAY);
+	QSharedPointer<redis_transaction_state> state(new redis_transaction_state);
+	state->callbacks = m_callbacks;
+	m_callbacks.clear();
+	m_state = state;
 
-	if (count <= 0)	return rr;
-
-	for (int i = 0; i < count; i++)
-	{
-		redis_reply* child = get_redis_object(sock);
-		if (child == 0) return 0;
-		child->setParent(rr);
-	}
-
-	return rr;
+	m_pipeline.add({"exec"});
+	return state;
 }
 
-QByteArray QRedis::read(QTcpSocket *sock, int len)
+QList<redis_reply> QRedisTransaction::exec()
 {
-	while (sock->bytesAvailable() < len) 
-	{
-		int ret = sock->waitForReadyRead(1000);
-		if (!ret) return "";
-	}
+	QSharedPointer<redis_transaction_state> state = start();
+	decode(state.data(), m_pipeline.exec());
+	m_pipeline.add({"multi"});
 
-	return sock->read(len);
+	return state->results;
 }
 
-QByteArray QRedis::readLine(QTcpSocket *sock)
+void QRedisTransaction::exec(const redis_transaction_callback &callback)
 {
-	if (sock->bytesAvailable() == 0)
+	QSharedPointer<redis_transaction_state> state = start();
+	m_pipeline.exec([state, callback](const QList<redis_reply> &replies)
 	{
-		bool ret = sock->waitForReadyRead(1000);
-		if (!ret) return "";
-	}
-	return sock->readLine();
+		decode(state.data(), replies);
+		if (callback) callback(state->results);
+	});
+	m_pipeline.add({"multi"});
 }
 
-void QRedis::error(QAbstractSocket::SocketError)
+bool QRedisTransaction::aborted() const
 {
-	qWarning() << "The following error occurred: " << m_sock->errorString();
+	return m_state && m_state->aborted;
 }
 
-void QRedis::check()
+QString QRedisTransaction::error() const
 {
-	if (!m_isconnected)
-	{
-		m_sock->connectToHost(m_ip, m_port);
-		m_subssock->connectToHost(m_ip, m_port);
-	}
+	if (!m_state) return QString();
+	return m_state->error;
 }
 
-void QRedis::disconnected()
+bool QRedisTransaction::hasErrors() const
 {
-	m_sock->close();
-	m_subssock->close();
-	m_isconnected = false;
+	return m_state && (!m_state->queueErrors.isEmpty() || !m_state->errors.isEmpty());
 }
 
-void QRedis::connected()
+QMap<int, QString> QRedisTransaction::queueErrors() const
 {
-	m_isconnected = true;
-	if (m_subssock != sender()) return;
+	if (!m_state) return QMap<int, QString>();
+	return m_state->queueErrors;
+}
 
-	foreach (const QString &value, m_channels)
-	{
-		subscribe(value);
-	}
-	foreach (const QString &value, m_pchannels)
-	{
-		psubscribe(value);
-	}
-}
\ No newline at end of file
+QMap<int, QString> QRedisTransaction::errors() const
+{
+	if (!m_state) return QMap<int, QString>();
+	return m_state->errors;
+}
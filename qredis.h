@@ -2,9 +2,27 @@
 #define _QREDIS_H_
 
 #include <QObject>
-#include <QTcpSocket>
 #include <QStringList>
 #include <QDateTime>
+#include <QQueue>
+#include <QMap>
+#include <QSharedPointer>
+#include <QCache>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QVector>
+#include <QSharedData>
+#include <QExplicitlySharedDataPointer>
+#include <initializer_list>
+#include <functional>
+#include <atomic>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "qredistransport.h"
+
+class QIODevice;
 
 typedef enum
 {
@@ -15,112 +33,832 @@ typedef enum
 	REDIS_RESULT_INTEGER,
 	REDIS_RESULT_STRING,
 	REDIS_RESULT_ARRAY,
+	REDIS_RESULT_MAP,
+	REDIS_RESULT_SET,
+	REDIS_RESULT_DOUBLE,
+	REDIS_RESULT_BOOLEAN,
+	REDIS_RESULT_BIGNUMBER,
+	REDIS_RESULT_PUSH,
 } redis_reply_t;
 
-class redis_reply : public QObject
+/*
+ * One element of a reply. Scalars point into the arena byte buffer,
+ * aggregates point at a contiguous run of child nodes in the same arena;
+ * the children of a map are its keys and values, alternating.
+ */
+struct redis_node
+{
+	redis_reply_t type;
+	int count;
+	union
+	{
+		qlonglong integer;
+		double real;
+		struct
+		{
+			int offset;
+			int length;
+		} str;
+		int first;
+	};
+};
+
+/*
+ * Storage shared by every element of one reply: a flat node vector and a
+ * single byte buffer, so a reply costs a handful of allocations no matter
+ * how many elements it has.
+ */
+class redis_arena : public QSharedData
+{
+public:
+	QVector<redis_node> nodes;
+	QByteArray bytes;
+};
+
+class redis_reply
+{
+public:
+	redis_reply();
+	redis_reply_t type() const;
+	qlonglong integer() const;
+	QString status() const;
+	QString error() const;
+	QString string() const;
+	QByteArray bytes() const;
+	qreal real() const;
+	bool boolean() const;
+	QString bignumber() const;
+	bool isAggregate() const;
+	int count() const;
+	redis_reply at(int i) const;
+	static redis_reply fromError(const QString &message);
+private:
+	friend class redis_parser;
+	redis_reply(redis_arena *arena, int index);
+	const redis_node *node() const;
+	QString text() const;
+private:
+	QExplicitlySharedDataPointer<redis_arena> arena_;
+	int index_;
+};
+
+/*
+ * Completion callbacks of the asynchronous command API. They are invoked
+ * from the socket's readyRead handling, in the order the commands were
+ * issued; a failed command delivers the type's default value and leaves
+ * the reason in QRedis::lastError().
+ */
+typedef std::function<void (const redis_reply &)> redis_callback;
+typedef std::function<void ()> redis_done_callback;
+typedef std::function<void (bool)> redis_bool_callback;
+typedef std::function<void (qlonglong)> redis_integer_callback;
+typedef std::function<void (qreal)> redis_real_callback;
+typedef std::function<void (const QString &)> redis_string_callback;
+typedef std::function<void (const QStringList &)> redis_string_list_callback;
+typedef std::function<void (const QByteArray &)> redis_bytes_callback;
+typedef std::function<void (const QList<QByteArray> &)> redis_bytes_list_callback;
+typedef std::function<void (const QDateTime &)> redis_time_callback;
+typedef std::function<void (const QString &, const QString &)> redis_string_pair_callback;
+typedef std::function<void (const QByteArray &, const QByteArray &)> redis_bytes_pair_callback;
+
+/*
+ * Typed decoding of a reply and everything nested in it. redis_decode()
+ * returns false when the reply or any element does not fit T, errors
+ * included; nil decodes to an empty or zero value. Scalars are bool, int,
+ * qlonglong, double, QByteArray, QString and redis_reply itself, which
+ * keeps an element as it is. Sequences are QList, QVector, QStringList
+ * and std::vector; QHash and QMap are filled from a RESP3 map or a flat
+ * key/value array; std::pair, QPair and std::tuple take an array of
+ * exactly that many elements.
+ */
+template<class T> struct redis_decoder;
+
+template<class T> inline bool redis_decode(const redis_reply &rr, T &value)
+{
+	return redis_decoder<T>::decode(rr, value);
+}
+
+template<class T> inline T redis_value(const redis_reply &rr)
+{
+	T value;
+	if (!redis_decode(rr, value)) return T();
+	return value;
+}
+
+template<> struct redis_decoder<redis_reply> { static bool decode(const redis_reply &rr, redis_reply &value); };
+template<> struct redis_decoder<bool> { static bool decode(const redis_reply &rr, bool &value); };
+template<> struct redis_decoder<int> { static bool decode(const redis_reply &rr, int &value); };
+template<> struct redis_decoder<qlonglong> { static bool decode(const redis_reply &rr, qlonglong &value); };
+template<> struct redis_decoder<double> { static bool decode(const redis_reply &rr, double &value); };
+template<> struct redis_decoder<QByteArray> { static bool decode(const redis_reply &rr, QByteArray &value); };
+template<> struct redis_decoder<QString> { static bool decode(const redis_reply &rr, QString &value); };
+
+template<class C> struct redis_sequence_decoder
+{
+	static bool decode(const redis_reply &rr, C &value)
+	{
+		value = C();
+		if (rr.type() == REDIS_RESULT_NIL) return true;
+		if (!rr.isAggregate()) return false;
+
+		int count = rr.count();
+		value.reserve(count);
+		for (int i = 0; i < count; i++)
+		{
+			typename C::value_type element;
+			if (!redis_decode(rr.at(i), element)) return false;
+			value.push_back(element);
+		}
+		return true;
+	}
+};
+
+template<class T> struct redis_decoder<QList<T> > : redis_sequence_decoder<QList<T> > {};
+template<class T> struct redis_decoder<QVector<T> > : redis_sequence_decoder<QVector<T> > {};
+template<class T> struct redis_decoder<std::vector<T> > : redis_sequence_decoder<std::vector<T> > {};
+template<> struct redis_decoder<QStringList> : redis_sequence_decoder<QStringList> {};
+
+template<class M> struct redis_map_decoder
+{
+	static bool decode(const redis_reply &rr, M &value)
+	{
+		value = M();
+		if (rr.type() == REDIS_RESULT_NIL) return true;
+		if (!rr.isAggregate() || rr.count() % 2 != 0) return false;
+
+		for (int i = 0; i < rr.count(); i += 2)
+		{
+			typename M::key_type key;
+			typename M::mapped_type mapped;
+			if (!redis_decode(rr.at(i), key) || !redis_decode(rr.at(i + 1), mapped)) return false;
+			value.insert(key, mapped);
+		}
+		return true;
+	}
+};
+
+template<class K, class V> struct redis_decoder<QHash<K, V> > : redis_map_decoder<QHash<K, V> > {};
+template<class K, class V> struct redis_decoder<QMap<K, V> > : redis_map_decoder<QMap<K, V> > {};
+
+template<class P> struct redis_pair_decoder
+{
+	static bool decode(const redis_reply &rr, P &value)
+	{
+		if (!rr.isAggregate() || rr.count() != 2) return false;
+		return redis_decode(rr.at(0), value.first) && redis_decode(rr.at(1), value.second);
+	}
+};
+
+template<class A, class B> struct redis_decoder<std::pair<A, B> > : redis_pair_decoder<std::pair<A, B> > {};
+template<class A, class B> struct redis_decoder<QPair<A, B> > : redis_pair_decoder<QPair<A, B> > {};
+
+template<int N, class... Ts> struct redis_tuple_decoder
+{
+	static bool decode(const redis_reply &rr, std::tuple<Ts...> &value)
+	{
+		return redis_tuple_decoder<N - 1, Ts...>::decode(rr, value) && redis_decode(rr.at(N - 1), std::get<N - 1>(value));
+	}
+};
+
+template<class... Ts> struct redis_tuple_decoder<0, Ts...>
+{
+	static bool decode(const redis_reply &, std::tuple<Ts...> &) { return true; }
+};
+
+template<class... Ts> struct redis_decoder<std::tuple<Ts...> >
+{
+	static bool decode(const redis_reply &rr, std::tuple<Ts...> &value)
+	{
+		if (!rr.isAggregate() || rr.count() != int(sizeof...(Ts))) return false;
+		return redis_tuple_decoder<sizeof...(Ts), Ts...>::decode(rr, value);
+	}
+};
+
+/*
+ * Where a reply goes while it is being parsed instead of being stored: a
+ * bulk string reply is written to sink, each element of an array reply of
+ * scalars is handed to visitor. Either way the reply itself only carries
+ * the byte or element count.
+ */
+struct redis_stream
+{
+	redis_stream(QIODevice *sink = 0) : sink(sink) {}
+	redis_stream(const redis_bytes_callback &visitor) : sink(0), visitor(visitor) {}
+	bool isNull() const { return !sink && !visitor; }
+	QIODevice *sink;
+	redis_bytes_callback visitor;
+};
+
+/*
+ * Resumable RESP parser. Bytes are fed in as they arrive from the socket,
+ * the parser keeps its position (including half-read lines, bulk payloads
+ * and partially filled arrays) between calls, and a reply is only queued
+ * once its whole frame has been received. Parsing stops after each reply
+ * until it is taken, so a stream set before the next feed() or hasReply()
+ * applies to the next reply only. RESP3 types are understood as well;
+ * verbatim strings lose their format tag and attributes are dropped.
+ */
+class redis_parser
+{
+public:
+	redis_parser();
+	~redis_parser();
+	void feed(const QByteArray &data);
+	void setStream(const redis_stream &stream);
+	bool hasReply();
+	redis_reply takeReply();
+	bool hasError() const;
+	void reset();
+private:
+	void parse();
+	redis_node &next();
+	void complete();
+	void drop_attribute();
+	void visit(const char *data, int len);
+private:
+	enum parse_state_t
+	{
+		PARSE_LINE,
+		PARSE_BULK,
+		PARSE_STREAM,
+		PARSE_ERROR,
+	};
+	struct parse_frame
+	{
+		int next;
+		int remaining;
+		bool attribute;
+	};
+	parse_state_t m_state;
+	QByteArray m_buffer;
+	int m_pos;
+	int m_bulklen;
+	char m_bulkprefix;
+	redis_stream m_stream;
+	int m_streamed;
+	bool m_sinkfailed;
+	int m_visitremaining;
+	int m_visited;
+	int m_visitskip;
+	bool m_visitnested;
+	bool m_visitfailed;
+	redis_arena *m_arena;
+	QVector<parse_frame> m_stack;
+	QQueue<redis_reply> m_replies;
+};
+
+/*
+ * One command argument as seen by redis_writer. Strings and byte arrays are
+ * referenced, not copied, so the viewed data must outlive the write call;
+ * integers are formatted into the argument itself.
+ */
+class redis_arg
+{
+public:
+	redis_arg(const char *str);
+	redis_arg(const QByteArray &data);
+	redis_arg(qlonglong value);
+	redis_arg(int value);
+	const char *data() const { return data_ ? data_ : digits_; }
+	int size() const { return size_; }
+	const QByteArray &bytes() const { return bytes_; }
+private:
+	QByteArray bytes_;
+	const char *data_;
+	int size_;
+	char digits_[24];
+};
+
+/*
+ * Large argument kept by reference; it belongs at offset in the buffer.
+ */
+struct redis_segment
+{
+	int offset;
+	QByteArray data;
+};
+
+/*
+ * Serializes commands as RESP multi-bulk frames. The frame size is computed
+ * before anything is written, so each command costs at most one (amortised)
+ * growth of a buffer that is kept across commands. Arguments of 64 KiB and
+ * more are not copied: only their headers go into the buffer and writeTo()
+ * hands them to the transport as separate chunks of one gathered write.
+ */
+class redis_writer
+{
+public:
+	redis_writer();
+	void append(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args = QList<QByteArray>());
+	void clear();
+	int size() const;
+	qint64 writeTo(QRedisTransport *transport) const;
+	QByteArray toByteArray(int from = 0) const;
+private:
+	char *reference(char *p, const QByteArray &data);
+	char *reserve(int len);
+private:
+	QByteArray m_buffer;
+	int m_size;
+	QVector<redis_segment> m_segments;
+	int m_external;
+};
+
+/*
+ * Command waiting for its reply. offset is where the command starts in the
+ * batch that has not been written yet, if it is part of it; such a command
+ * never reached the server and goes to the next connection as it is. Once
+ * written, the encoded command is kept only for an idempotent read that may
+ * be sent again after a reconnect. A reply with a stream is handed to it by
+ * the parser.
+ */
+struct redis_pending
+{
+	redis_pending() : offset(-1), attempts(0), idempotent(false) {}
+	redis_pending(const redis_callback &callback, const QByteArray &command = QByteArray(), bool idempotent = false, const redis_stream &stream = redis_stream()) : callback(callback), command(command), offset(-1), attempts(0), idempotent(idempotent), stream(stream) {}
+	redis_callback callback;
+	QByteArray command;
+	int offset;
+	int attempts;
+	bool idempotent;
+	redis_stream stream;
+};
+
+/*
+ * Replies to commands sent after one that has to be sent again, held back
+ * so that callbacks still run in the order the commands were issued.
+ */
+struct redis_hold
+{
+	redis_hold() : released(false) {}
+	QList<QPair<redis_callback, redis_reply> > replies;
+	bool released;
+};
+
+/*
+ * Command handed to a threaded QRedis by another thread.
+ */
+struct redis_submission
+{
+	quint64 id;
+	QList<QByteArray> cmd;
+	redis_callback callback;
+	redis_submission *next;
+};
+
+/*
+ * Lock-free multi-producer, single-consumer queue: producers push onto an
+ * intrusive stack with a CAS, the I/O thread takes the whole stack at once
+ * and reverses it back into submission order.
+ */
+class redis_submit_queue
+{
+public:
+	redis_submit_queue();
+	~redis_submit_queue();
+	bool push(redis_submission *s);
+	redis_submission *takeAll();
+private:
+	std::atomic<redis_submission *> m_head;
+};
+
+/*
+ * Values cached for one key, by the command that read them: "get",
+ * "hgetall" or "hget <field>".
+ */
+struct redis_cache_entry
+{
+	QHash<QByteArray, QList<QByteArray> > values;
+};
+
+/*
+ * Client-side cache kept in step with the server through CLIENT TRACKING.
+ * Entries are charged by size against a byte budget and evicted least
+ * recently used first. begin() numbers every fetch; invalidations arriving
+ * while fetches are in flight are remembered until the last of them ends,
+ * so a reply that may have been overtaken by a write is never stored.
+ */
+class redis_cache
+{
+public:
+	redis_cache();
+	void setBudget(int bytes);
+	int budget() const;
+	bool isEnabled() const;
+	void setPrefixes(const QList<QByteArray> &prefixes);
+	const QList<QByteArray> &prefixes() const;
+	bool isCacheable(const QByteArray &key) const;
+	const QList<QByteArray> *find(const QByteArray &key, const QByteArray &sub);
+	void record(bool hit);
+	quint64 begin();
+	void store(const QByteArray &key, const QByteArray &sub, quint64 since, const QList<QByteArray> &values);
+	void end(quint64 since);
+	void invalidate(const QByteArray &key);
+	void clear();
+	qlonglong hits() const;
+	qlonglong misses() const;
+private:
+	Q_DISABLE_COPY(redis_cache)
+	QCache<QByteArray, redis_cache_entry> m_entries;
+	QList<QByteArray> m_prefixes;
+	QHash<QByteArray, quint64> m_invalidated;
+	quint64 m_seq;
+	quint64 m_flushed;
+	int m_fetches;
+	qlonglong m_hits;
+	qlonglong m_misses;
+};
+
+/*
+ * Lua script with the SHA1 of its source, computed once so that eval() can
+ * send EVALSHA instead of the whole script.
+ */
+class QRedisScript
 {
-	Q_OBJECT
 public:
-	redis_reply(QObject * parent = 0);
-	redis_reply_t type();
-	qlonglong integer();
-	QString status();
-	QString error();
-	QString string();
-	void setData(const QString &data);
-	void setType(redis_reply_t type);
+	explicit QRedisScript(const QString &source);
+	const QByteArray &source() const { return m_source; }
+	const QByteArray &sha1() const { return m_sha1; }
 private:
-	redis_reply_t reply_type_;
-	QString str;
+	QByteArray m_source;
+	QByteArray m_sha1;
+};
+
+/*
+ * Reply decoders of the command table: the result type of a command, the
+ * callback type of its asynchronous form and, through QRedis::reply_as(),
+ * the reply_*() conversion between them. redis_as_integer carries the
+ * value a failed command yields; redis_as_lines splits a single string
+ * into its non-empty lines.
+ */
+struct redis_as_done { typedef void result_type; typedef redis_done_callback callback_type; };
+struct redis_as_bool { typedef bool result_type; typedef redis_bool_callback callback_type; };
+struct redis_as_status { typedef bool result_type; typedef redis_bool_callback callback_type; };
+struct redis_as_pong { typedef bool result_type; typedef redis_bool_callback callback_type; };
+template<int Fallback> struct redis_as_integer { typedef qlonglong result_type; typedef redis_integer_callback callback_type; };
+struct redis_as_real { typedef qreal result_type; typedef redis_real_callback callback_type; };
+struct redis_as_string { typedef QString result_type; typedef redis_string_callback callback_type; };
+struct redis_as_bytes { typedef QByteArray result_type; typedef redis_bytes_callback callback_type; };
+struct redis_as_strings { typedef QStringList result_type; typedef redis_string_list_callback callback_type; };
+struct redis_as_list { typedef QList<QByteArray> result_type; typedef redis_bytes_list_callback callback_type; };
+struct redis_as_lines { typedef QStringList result_type; typedef redis_string_list_callback callback_type; };
+struct redis_as_time { typedef QDateTime result_type; typedef redis_time_callback callback_type; };
+
+/*
+ * Compile-time description of a command: its name, an optional subcommand
+ * and, by type, how its reply is decoded. The blocking, asynchronous,
+ * pipelined and coroutine forms of a command are all generated from its
+ * descriptor; the table, and which commands are left out of it, is in
+ * qrediscommands.h.
+ */
+template<class D> struct redis_command
+{
+	const char *name;
+	const char *subcommand;
 };
 
+class QThread;
+class QTimer;
+
 class QRedis : public QObject
 {
 	Q_OBJECT
+	friend class QRedisPipeline;
+	friend class QRedisTransaction;
+	friend class QRedisPool;
+	friend class QRedisCoro;
 public:
 	QRedis(QObject * parent = 0);
 	~QRedis();
 public:
+	enum Backend
+	{
+		QtBackend,
+		EpollBackend,
+		UringBackend
+	};
+	/*
+	 * Socket implementation used by the next connectHost(). EpollBackend
+	 * and UringBackend fall back to QtBackend where they are not available.
+	 */
+	void setBackend(Backend backend);
 	void connectHost(const QString &host, const quint16 port = 6379);
+	void connectUnix(const QString &path);
+	/*
+	 * Commands issued within one event-loop iteration are coalesced into a
+	 * single write; a batch is sent early once it reaches either limit.
+	 */
+	void setMaxBatch(int commands, int bytes);
+	/*
+	 * Deadline of a blocking call, covering the whole reply; -1 waits
+	 * forever and 0 only takes a reply that has already arrived.
+	 * withTimeout() overrides it for the next blocking call only:
+	 * redis.withTimeout(50).get("key").
+	 */
+	void setTimeout(int msecs);
+	int timeout() const;
+	QRedis &withTimeout(int msecs);
+	/*
+	 * After a connection loss reconnects are attempted with exponential
+	 * backoff from base up to max msecs, each delay randomised down to half
+	 * of it. Async commands issued meanwhile are held, up to queueLimit,
+	 * and sent once auth, hello, select and client setname have been
+	 * replayed.
+	 * Commands not yet written to the lost connection are sent on the new
+	 * one. Of those already written, idempotent reads are resent up to
+	 * setReadRetries() times; anything else fails with "connection lost",
+	 * as it may have run.
+	 */
+	void setReconnect(int baseMsecs, int maxMsecs, int queueLimit = 1024);
+	void setReadRetries(int retries);
+	/*
+	 * Moves the connection to its own I/O thread; call after connecting, on
+	 * an object without a parent. From then on other threads must only use
+	 * submit() and command(), whose callbacks run on the I/O thread; every
+	 * submission is also answered by completed(), which reaches receivers
+	 * in other threads as a queued signal.
+	 */
+	bool startThread();
+	void stopThread();
+	quint64 submit(const QList<QByteArray> &cmd, const redis_callback &callback = redis_callback());
 public:
+	///////////////////////generic//////////////////////////////
+	redis_reply command(const QList<QByteArray> &cmd);
+	void command(const QList<QByteArray> &cmd, const redis_callback &callback);
+	///////////////////////streaming//////////////////////////////
+	/*
+	 * The value is written to sink as it arrives instead of being held in
+	 * memory. The result is the number of bytes written, or -1 when the key
+	 * does not exist or the sink failed. The sink must stay open until the
+	 * reply is complete; large values can also be fetched piecewise through
+	 * getrange().
+	 */
+	qlonglong get(const QString &key, QIODevice *sink);
+	void get(const QString &key, QIODevice *sink, const redis_integer_callback &callback);
+	qlonglong getRaw(const QByteArray &key, QIODevice *sink);
+	void getRaw(const QByteArray &key, QIODevice *sink, const redis_integer_callback &callback);
+	qlonglong getrange(const QString &key, qlonglong start, qlonglong stop, QIODevice *sink);
+	void getrange(const QString &key, qlonglong start, qlonglong stop, QIODevice *sink, const redis_integer_callback &callback);
+	qlonglong getrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop, QIODevice *sink);
+	void getrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop, QIODevice *sink, const redis_integer_callback &callback);
+	/*
+	 * Each element is handed to visitor as soon as it is parsed, without
+	 * building the reply or a list of all elements. The result is the
+	 * number of elements (fields for hgetallEach), or -1 on error.
+	 * Visitors must not make blocking calls.
+	 */
+	qlonglong hgetallEach(const QString &key, const redis_string_pair_callback &visitor);
+	void hgetallEach(const QString &key, const redis_string_pair_callback &visitor, const redis_integer_callback &callback);
+	qlonglong hgetallEachRaw(const QByteArray &key, const redis_bytes_pair_callback &visitor);
+	void hgetallEachRaw(const QByteArray &key, const redis_bytes_pair_callback &visitor, const redis_integer_callback &callback);
+	qlonglong hkeysEach(const QString &key, const redis_string_callback &visitor);
+	void hkeysEach(const QString &key, const redis_string_callback &visitor, const redis_integer_callback &callback);
+	qlonglong hkeysEachRaw(const QByteArray &key, const redis_bytes_callback &visitor);
+	void hkeysEachRaw(const QByteArray &key, const redis_bytes_callback &visitor, const redis_integer_callback &callback);
+	qlonglong hvalsEach(const QString &key, const redis_string_callback &visitor);
+	void hvalsEach(const QString &key, const redis_string_callback &visitor, const redis_integer_callback &callback);
+	qlonglong hvalsEachRaw(const QByteArray &key, const redis_bytes_callback &visitor);
+	void hvalsEachRaw(const QByteArray &key, const redis_bytes_callback &visitor, const redis_integer_callback &callback);
+	qlonglong lrangeEach(const QString &key, qlonglong start, qlonglong stop, const redis_string_callback &visitor);
+	void lrangeEach(const QString &key, qlonglong start, qlonglong stop, const redis_string_callback &visitor, const redis_integer_callback &callback);
+	qlonglong lrangeEachRaw(const QByteArray &key, qlonglong start, qlonglong stop, const redis_bytes_callback &visitor);
+	void lrangeEachRaw(const QByteArray &key, qlonglong start, qlonglong stop, const redis_bytes_callback &visitor, const redis_integer_callback &callback);
+	qlonglong smembersEach(const QString &key, const redis_string_callback &visitor);
+	void smembersEach(const QString &key, const redis_string_callback &visitor, const redis_integer_callback &callback);
+	qlonglong smembersEachRaw(const QByteArray &key, const redis_bytes_callback &visitor);
+	void smembersEachRaw(const QByteArray &key, const redis_bytes_callback &visitor, const redis_integer_callback &callback);
 	///////////////////////key//////////////////////////////
 	int del(const QString &key);
+	void del(const QString &key, const redis_integer_callback &callback);
 	int del(const QStringList &keys);
+	void del(const QStringList &keys, const redis_integer_callback &callback);
 	bool exists(const QString &key);
+	void exists(const QString &key, const redis_bool_callback &callback);
 	bool expire(const QString &key, qlonglong secs);
+	void expire(const QString &key, qlonglong secs, const redis_bool_callback &callback);
 	bool expireat(const QString &key, qlonglong timestamp);
+	void expireat(const QString &key, qlonglong timestamp, const redis_bool_callback &callback);
 	QStringList keys(const QString &pattern);
+	void keys(const QString &pattern, const redis_string_list_callback &callback);
 	bool move(const QString &key, int db);
+	void move(const QString &key, int db, const redis_bool_callback &callback);
 	bool persist(const QString &key);
+	void persist(const QString &key, const redis_bool_callback &callback);
 	bool pexpire(const QString &key, qlonglong mils);
+	void pexpire(const QString &key, qlonglong mils, const redis_bool_callback &callback);
 	bool pexpireat(const QString &key, qlonglong milstimestamp);
+	void pexpireat(const QString &key, qlonglong milstimestamp, const redis_bool_callback &callback);
 	qlonglong pttl(const QString &key);
+	void pttl(const QString &key, const redis_integer_callback &callback);
 	QString randomkey();
+	void randomkey(const redis_string_callback &callback);
 	bool rename(const QString &key, const QString &newkey);
+	void rename(const QString &key, const QString &newkey, const redis_bool_callback &callback);
 	bool renamenx(const QString &key, const QString &newkey);
+	void renamenx(const QString &key, const QString &newkey, const redis_bool_callback &callback);
 	qlonglong ttl(const QString &key);
+	void ttl(const QString &key, const redis_integer_callback &callback);
 	QString type(const QString &key);
+	void type(const QString &key, const redis_string_callback &callback);
 	///////////////////////string//////////////////////////////
 	int append(const QString &key, const QString &value);
+	void append(const QString &key, const QString &value, const redis_integer_callback &callback);
+	int appendRaw(const QByteArray &key, const QByteArray &value);
+	void appendRaw(const QByteArray &key, const QByteArray &value, const redis_integer_callback &callback);
 	qlonglong decr(const QString &key);
+	void decr(const QString &key, const redis_integer_callback &callback);
 	qlonglong decrby(const QString &key, qlonglong value);
+	void decrby(const QString &key, qlonglong value, const redis_integer_callback &callback);
 	QString get(const QString &key);
+	void get(const QString &key, const redis_string_callback &callback);
+	QByteArray getRaw(const QByteArray &key);
+	void getRaw(const QByteArray &key, const redis_bytes_callback &callback);
 	QString getrange(const QString &key, qlonglong start, qlonglong stop);
+	void getrange(const QString &key, qlonglong start, qlonglong stop, const redis_string_callback &callback);
+	QByteArray getrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop);
+	void getrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop, const redis_bytes_callback &callback);
 	QString getset(const QString &key, const QString &value);
+	void getset(const QString &key, const QString &value, const redis_string_callback &callback);
+	QByteArray getsetRaw(const QByteArray &key, const QByteArray &value);
+	void getsetRaw(const QByteArray &key, const QByteArray &value, const redis_bytes_callback &callback);
 	qlonglong incr(const QString &key);
+	void incr(const QString &key, const redis_integer_callback &callback);
 	qlonglong incrby(const QString &key, qlonglong value);
+	void incrby(const QString &key, qlonglong value, const redis_integer_callback &callback);
 	qreal incrbyfloat(const QString &key, qreal value);
+	void incrbyfloat(const QString &key, qreal value, const redis_real_callback &callback);
 	QStringList mget(const QStringList &keys);
+	void mget(const QStringList &keys, const redis_string_list_callback &callback);
+	QList<QByteArray> mgetRaw(const QList<QByteArray> &keys);
+	void mgetRaw(const QList<QByteArray> &keys, const redis_bytes_list_callback &callback);
 	void mset(const QStringList &keyvalues);
+	void mset(const QStringList &keyvalues, const redis_done_callback &callback);
+	void msetRaw(const QList<QByteArray> &keyvalues);
+	void msetRaw(const QList<QByteArray> &keyvalues, const redis_done_callback &callback);
 	bool msetnx(const QStringList &keyvalues);
+	void msetnx(const QStringList &keyvalues, const redis_bool_callback &callback);
+	bool msetnxRaw(const QList<QByteArray> &keyvalues);
+	void msetnxRaw(const QList<QByteArray> &keyvalues, const redis_bool_callback &callback);
 	bool psetex(const QString &key, qlonglong mils, const QString &value);
+	void psetex(const QString &key, qlonglong mils, const QString &value, const redis_bool_callback &callback);
+	bool psetexRaw(const QByteArray &key, qlonglong mils, const QByteArray &value);
+	void psetexRaw(const QByteArray &key, qlonglong mils, const QByteArray &value, const redis_bool_callback &callback);
 	bool set(const QString &key, const QString &value);
+	void set(const QString &key, const QString &value, const redis_bool_callback &callback);
+	bool setRaw(const QByteArray &key, const QByteArray &value);
+	void setRaw(const QByteArray &key, const QByteArray &value, const redis_bool_callback &callback);
 	bool setex(const QString &key, qlonglong secs, const QString &value);
+	void setex(const QString &key, qlonglong secs, const QString &value, const redis_bool_callback &callback);
+	bool setexRaw(const QByteArray &key, qlonglong secs, const QByteArray &value);
+	void setexRaw(const QByteArray &key, qlonglong secs, const QByteArray &value, const redis_bool_callback &callback);
 	bool setnx(const QString &key, const QString &value);
+	void setnx(const QString &key, const QString &value, const redis_bool_callback &callback);
+	bool setnxRaw(const QByteArray &key, const QByteArray &value);
+	void setnxRaw(const QByteArray &key, const QByteArray &value, const redis_bool_callback &callback);
 	qlonglong setrange(const QString &key, qlonglong offset, const QString &value);
+	void setrange(const QString &key, qlonglong offset, const QString &value, const redis_integer_callback &callback);
+	qlonglong setrangeRaw(const QByteArray &key, qlonglong offset, const QByteArray &value);
+	void setrangeRaw(const QByteArray &key, qlonglong offset, const QByteArray &value, const redis_integer_callback &callback);
 	qlonglong strlen(const QString &key);
+	void strlen(const QString &key, const redis_integer_callback &callback);
 	///////////////////////hash//////////////////////////////
 	qlonglong hdel(const QString &key, const QString &field);
+	void hdel(const QString &key, const QString &field, const redis_integer_callback &callback);
+	qlonglong hdelRaw(const QByteArray &key, const QByteArray &field);
+	void hdelRaw(const QByteArray &key, const QByteArray &field, const redis_integer_callback &callback);
 	qlonglong hdel(const QString &key, const QStringList &fields);
-	bool hexists(const QString &key);
+	void hdel(const QString &key, const QStringList &fields, const redis_integer_callback &callback);
+	qlonglong hdelRaw(const QByteArray &key, const QList<QByteArray> &fields);
+	void hdelRaw(const QByteArray &key, const QList<QByteArray> &fields, const redis_integer_callback &callback);
+	bool hexists(const QString &key, const QString &field);
+	void hexists(const QString &key, const QString &field, const redis_bool_callback &callback);
 	QString hget(const QString &key, const QString &field);
+	void hget(const QString &key, const QString &field, const redis_string_callback &callback);
+	QByteArray hgetRaw(const QByteArray &key, const QByteArray &field);
+	void hgetRaw(const QByteArray &key, const QByteArray &field, const redis_bytes_callback &callback);
 	QStringList hgetall(const QString &key);
+	void hgetall(const QString &key, const redis_string_list_callback &callback);
+	QList<QByteArray> hgetallRaw(const QByteArray &key);
+	void hgetallRaw(const QByteArray &key, const redis_bytes_list_callback &callback);
 	qlonglong hincrby(const QString &key, const QString &field, qlonglong value);
+	void hincrby(const QString &key, const QString &field, qlonglong value, const redis_integer_callback &callback);
 	qreal hincrbyfloat(const QString &key, const QString &field, qreal value);
+	void hincrbyfloat(const QString &key, const QString &field, qreal value, const redis_real_callback &callback);
 	QStringList hkeys(const QString &key);
+	void hkeys(const QString &key, const redis_string_list_callback &callback);
+	QList<QByteArray> hkeysRaw(const QByteArray &key);
+	void hkeysRaw(const QByteArray &key, const redis_bytes_list_callback &callback);
 	qlonglong hlen(const QString &key);
+	void hlen(const QString &key, const redis_integer_callback &callback);
 	QStringList hmget(const QString &key, const QStringList &fields);
+	void hmget(const QString &key, const QStringList &fields, const redis_string_list_callback &callback);
+	QList<QByteArray> hmgetRaw(const QByteArray &key, const QList<QByteArray> &fields);
+	void hmgetRaw(const QByteArray &key, const QList<QByteArray> &fields, const redis_bytes_list_callback &callback);
 	bool hmset(const QString &key, const QStringList &fvs);
+	void hmset(const QString &key, const QStringList &fvs, const redis_bool_callback &callback);
+	bool hmsetRaw(const QByteArray &key, const QList<QByteArray> &fvs);
+	void hmsetRaw(const QByteArray &key, const QList<QByteArray> &fvs, const redis_bool_callback &callback);
 	int hset(const QString &key, const QString &field, const QString &value);
+	void hset(const QString &key, const QString &field, const QString &value, const redis_integer_callback &callback);
+	int hsetRaw(const QByteArray &key, const QByteArray &field, const QByteArray &value);
+	void hsetRaw(const QByteArray &key, const QByteArray &field, const QByteArray &value, const redis_integer_callback &callback);
 	bool hsetnx(const QString &key, const QString &field, const QString &value);
+	void hsetnx(const QString &key, const QString &field, const QString &value, const redis_bool_callback &callback);
+	bool hsetnxRaw(const QByteArray &key, const QByteArray &field, const QByteArray &value);
+	void hsetnxRaw(const QByteArray &key, const QByteArray &field, const QByteArray &value, const redis_bool_callback &callback);
 	QStringList hvals(const QString &key);
+	void hvals(const QString &key, const redis_string_list_callback &callback);
+	QList<QByteArray> hvalsRaw(const QByteArray &key);
+	void hvalsRaw(const QByteArray &key, const redis_bytes_list_callback &callback);
 	///////////////////////list//////////////////////////////
 	QString lindex(const QString &key, qlonglong index);
+	void lindex(const QString &key, qlonglong index, const redis_string_callback &callback);
+	QByteArray lindexRaw(const QByteArray &key, qlonglong index);
+	void lindexRaw(const QByteArray &key, qlonglong index, const redis_bytes_callback &callback);
 	qlonglong llen(const QString &key);
+	void llen(const QString &key, const redis_integer_callback &callback);
 	QString lpop(const QString &key);
+	void lpop(const QString &key, const redis_string_callback &callback);
+	QByteArray lpopRaw(const QByteArray &key);
+	void lpopRaw(const QByteArray &key, const redis_bytes_callback &callback);
 	qlonglong lpush(const QString &key, const QString &value);
+	void lpush(const QString &key, const QString &value, const redis_integer_callback &callback);
+	qlonglong lpushRaw(const QByteArray &key, const QByteArray &value);
+	void lpushRaw(const QByteArray &key, const QByteArray &value, const redis_integer_callback &callback);
 	qlonglong lpush(const QString &key, const QStringList &values);
+	void lpush(const QString &key, const QStringList &values, const redis_integer_callback &callback);
+	qlonglong lpushRaw(const QByteArray &key, const QList<QByteArray> &values);
+	void lpushRaw(const QByteArray &key, const QList<QByteArray> &values, const redis_integer_callback &callback);
 	QStringList lrange(const QString &key, qlonglong start, qlonglong stop);
+	void lrange(const QString &key, qlonglong start, qlonglong stop, const redis_string_list_callback &callback);
+	QList<QByteArray> lrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop);
+	void lrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop, const redis_bytes_list_callback &callback);
 	qlonglong lrem(const QString &key, int count, const QString &value);
+	void lrem(const QString &key, int count, const QString &value, const redis_integer_callback &callback);
+	qlonglong lremRaw(const QByteArray &key, int count, const QByteArray &value);
+	void lremRaw(const QByteArray &key, int count, const QByteArray &value, const redis_integer_callback &callback);
 	bool lset(const QString &key, int index, const QString &value);
+	void lset(const QString &key, int index, const QString &value, const redis_bool_callback &callback);
+	bool lsetRaw(const QByteArray &key, int index, const QByteArray &value);
+	void lsetRaw(const QByteArray &key, int index, const QByteArray &value, const redis_bool_callback &callback);
 	QString rpop(const QString &key);
+	void rpop(const QString &key, const redis_string_callback &callback);
+	QByteArray rpopRaw(const QByteArray &key);
+	void rpopRaw(const QByteArray &key, const redis_bytes_callback &callback);
 	qlonglong rpush(const QString &key, const QString &value);
+	void rpush(const QString &key, const QString &value, const redis_integer_callback &callback);
+	qlonglong rpushRaw(const QByteArray &key, const QByteArray &value);
+	void rpushRaw(const QByteArray &key, const QByteArray &value, const redis_integer_callback &callback);
 	qlonglong rpush(const QString &key, const QStringList &values);
+	void rpush(const QString &key, const QStringList &values, const redis_integer_callback &callback);
+	qlonglong rpushRaw(const QByteArray &key, const QList<QByteArray> &values);
+	void rpushRaw(const QByteArray &key, const QList<QByteArray> &values, const redis_integer_callback &callback);
 	///////////////////////set//////////////////////////////
 	qlonglong sadd(const QString &key, const QString &value);
+	void sadd(const QString &key, const QString &value, const redis_integer_callback &callback);
+	qlonglong saddRaw(const QByteArray &key, const QByteArray &value);
+	void saddRaw(const QByteArray &key, const QByteArray &value, const redis_integer_callback &callback);
 	qlonglong sadd(const QString &key, const QStringList &values);
+	void sadd(const QString &key, const QStringList &values, const redis_integer_callback &callback);
+	qlonglong saddRaw(const QByteArray &key, const QList<QByteArray> &values);
+	void saddRaw(const QByteArray &key, const QList<QByteArray> &values, const redis_integer_callback &callback);
 	qlonglong scard(const QString &key);
+	void scard(const QString &key, const redis_integer_callback &callback);
 	QStringList sdiff(const QStringList &keys);
+	void sdiff(const QStringList &keys, const redis_string_list_callback &callback);
+	QList<QByteArray> sdiffRaw(const QList<QByteArray> &keys);
+	void sdiffRaw(const QList<QByteArray> &keys, const redis_bytes_list_callback &callback);
 	QStringList sinter(const QStringList &keys);
+	void sinter(const QStringList &keys, const redis_string_list_callback &callback);
+	QList<QByteArray> sinterRaw(const QList<QByteArray> &keys);
+	void sinterRaw(const QList<QByteArray> &keys, const redis_bytes_list_callback &callback);
 	bool sismember(const QString &key, const QString &value);
+	void sismember(const QString &key, const QString &value, const redis_bool_callback &callback);
+	bool sismemberRaw(const QByteArray &key, const QByteArray &value);
+	void sismemberRaw(const QByteArray &key, const QByteArray &value, const redis_bool_callback &callback);
 	QStringList smembers(const QString &key);
+	void smembers(const QString &key, const redis_string_list_callback &callback);
+	QList<QByteArray> smembersRaw(const QByteArray &key);
+	void smembersRaw(const QByteArray &key, const redis_bytes_list_callback &callback);
 	qlonglong srem(const QString &key, const QString &value);
+	void srem(const QString &key, const QString &value, const redis_integer_callback &callback);
+	qlonglong sremRaw(const QByteArray &key, const QByteArray &value);
+	void sremRaw(const QByteArray &key, const QByteArray &value, const redis_integer_callback &callback);
 	qlonglong srem(const QString &key, const QStringList &values);
+	void srem(const QString &key, const QStringList &values, const redis_integer_callback &callback);
+	qlonglong sremRaw(const QByteArray &key, const QList<QByteArray> &values);
+	void sremRaw(const QByteArray &key, const QList<QByteArray> &values, const redis_integer_callback &callback);
 	QStringList sunion(const QStringList &keys);
+	void sunion(const QStringList &keys, const redis_string_list_callback &callback);
+	QList<QByteArray> sunionRaw(const QList<QByteArray> &keys);
+	void sunionRaw(const QList<QByteArray> &keys, const redis_bytes_list_callback &callback);
 	///////////////////////pub/sub//////////////////////////////
 	void psubscribe(const QString &pattern);
 	void psubscribe(const QStringList &patterns);
 	int publish(const QString &channel, const QString &data);
+	void publish(const QString &channel, const QString &data, const redis_integer_callback &callback);
+	int publishRaw(const QByteArray &channel, const QByteArray &data);
+	void publishRaw(const QByteArray &channel, const QByteArray &data, const redis_integer_callback &callback);
 	void punsubscribe();
 	void punsubscribe(const QString &pattern);
 	void punsubscribe(const QStringList &patterns);
@@ -129,58 +867,452 @@ public:
 	void unsubscribe();
 	void unsubscribe(const QString &channel);
 	void unsubscribe(const QStringList &channels);
+	///////////////////////transaction//////////////////////////////
+	bool watch(const QString &key);
+	void watch(const QString &key, const redis_bool_callback &callback);
+	bool watch(const QStringList &keys);
+	void watch(const QStringList &keys, const redis_bool_callback &callback);
+	bool watchRaw(const QList<QByteArray> &keys);
+	void watchRaw(const QList<QByteArray> &keys, const redis_bool_callback &callback);
+	bool unwatch();
+	void unwatch(const redis_bool_callback &callback);
 	///////////////////////script//////////////////////////////
 	QStringList eval(const QString &script, const QStringList &args);
+	void eval(const QString &script, const QStringList &args, const redis_string_list_callback &callback);
+	/*
+	 * eval() sends EVALSHA with the SHA1 computed locally, and when the
+	 * server answers NOSCRIPT loads the script and sends it once more; the
+	 * callback still runs before those of commands issued after it.
+	 * Registered scripts are loaded with SCRIPT LOAD on every connect, so
+	 * they never take the extra round trip.
+	 */
+	QStringList eval(const QRedisScript &script, const QStringList &args);
+	void eval(const QRedisScript &script, const QStringList &args, const redis_string_list_callback &callback);
+	void registerScript(const QRedisScript &script);
+	/*
+	 * The script's reply as it is, to be taken apart with redis_decode():
+	 * redis_decode(redis.evalRaw(script, args), rows).
+	 */
+	redis_reply evalRaw(const QRedisScript &script, const QList<QByteArray> &args);
+	void evalRaw(const QRedisScript &script, const QList<QByteArray> &args, const redis_callback &callback);
+	redis_reply evalshaRaw(const QByteArray &sha1, const QList<QByteArray> &args);
+	void evalshaRaw(const QByteArray &sha1, const QList<QByteArray> &args, const redis_callback &callback);
 	QStringList evalsha(const QString &sha1, const QStringList &args);
+	void evalsha(const QString &sha1, const QStringList &args, const redis_string_list_callback &callback);
 	bool scriptexists(const QString &sha1);
+	void scriptexists(const QString &sha1, const redis_bool_callback &callback);
 	QStringList scriptexists(const QStringList &sha1s);
+	void scriptexists(const QStringList &sha1s, const redis_string_list_callback &callback);
 	void scriptflush();
+	void scriptflush(const redis_done_callback &callback);
 	void scriptkill();
+	void scriptkill(const redis_done_callback &callback);
 	QString scriptload(const QString &script);
+	void scriptload(const QString &script, const redis_string_callback &callback);
 	///////////////////////connection//////////////////////////////
 	bool auth(const QString &pw);
+	void auth(const QString &pw, const redis_bool_callback &callback);
 	bool ping();
+	void ping(const redis_bool_callback &callback);
 	void quit();
+	void quit(const redis_done_callback &callback);
 	bool select(int db);
+	void select(int db, const redis_bool_callback &callback);
+	/*
+	 * Switches the connection to the given protocol version, replayed after
+	 * a reconnect like auth and select. Under RESP3 subscriptions move onto
+	 * the command connection: messages still reach subscribe(), any other
+	 * out-of-band push frame is emitted as push().
+	 */
+	bool hello(int protover = 3);
+	void hello(int protover, const redis_bool_callback &callback);
+	int protocol() const;
+	/*
+	 * Serves get, mget, hget and hgetall (and their Raw variants) from a
+	 * local cache of up to budget bytes that the server invalidates through
+	 * CLIENT TRACKING: with push frames under RESP3, otherwise redirected to
+	 * the subscriber connection. Given prefixes, only keys starting with one
+	 * of them are cached and tracking runs in BCAST mode. A hit is served
+	 * only while no earlier reply is outstanding, so replies keep their
+	 * order; select() and connection losses empty the cache. Under RESP2
+	 * the invalidation of this client's own write may arrive after its
+	 * reply, so the keys a command writes are dropped when it is sent;
+	 * writes made through QRedisPipeline or QRedisTransaction are not, and
+	 * a read right after them may still see the old value.
+	 */
+	void enableCache(int budget, const QStringList &prefixes = QStringList());
+	void disableCache();
+	qlonglong cacheHits() const;
+	qlonglong cacheMisses() const;
 	///////////////////////server//////////////////////////////
 	bool bgsave();
+	void bgsave(const redis_bool_callback &callback);
 	QString clientgetname();
+	void clientgetname(const redis_string_callback &callback);
 	bool clientkill(const QString &ipport);
+	void clientkill(const QString &ipport, const redis_bool_callback &callback);
 	QStringList clientlist();
+	void clientlist(const redis_string_list_callback &callback);
 	bool clientsetname(const QString &name);
+	void clientsetname(const QString &name, const redis_bool_callback &callback);
 	qlonglong dbsize();
+	void dbsize(const redis_integer_callback &callback);
 	void flushall();
+	void flushall(const redis_done_callback &callback);
 	void flushdb();
+	void flushdb(const redis_done_callback &callback);
 	QString info();
+	void info(const redis_string_callback &callback);
 	QDateTime time();
+	void time(const redis_time_callback &callback);
 	///////////////////////other//////////////////////////////
 	QString lastError() { return m_error; }
+	bool isConnected() const { return m_sock && m_sock->isConnected(); }
 signals:
 	void subscribe(const QString &channel, const QString &data);
+	void subscribeRaw(const QByteArray &channel, const QByteArray &data);
+	void push(const redis_reply &reply);
+	void completed(quint64 id, const redis_reply &reply);
 private slots:
-	void check();
+	void reconnect();
 	void disconnected();
 	void connected();
 	void readyRead();
-	void error(QAbstractSocket::SocketError);
+	void replyRead();
+	void flushPending();
+	void dispatchDeferred();
+	void drainSubmissions();
+	void detachThread();
+	void error();
 protected:
-	QByteArray format(const QList<QByteArray> &cmd);
-	QByteArray read(QTcpSocket *sock, int len);
-	QByteArray readLine(QTcpSocket *sock);
-	redis_reply* get_redis_object(QTcpSocket *sock);
-	redis_reply* get_redis_error(QTcpSocket *sock);
-	redis_reply* get_redis_status(QTcpSocket *sock);
-	redis_reply* get_redis_integer(QTcpSocket *sock);
-	redis_reply* get_redis_string(QTcpSocket *sock);
-	redis_reply* get_redis_array(QTcpSocket *sock);
+	QRedisTransport *create_transport(const QString &host, quint16 port);
+	void open(QRedisTransport *sock, QRedisTransport *subssock);
+	void subscriber_send(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args = QList<QByteArray>());
+	bool uses_subscriber() const;
+	void resubscribe();
+	bool dispatch_message(const redis_reply &rr);
+	bool invalidation_message(const redis_reply &rr);
+	void subscriber_reply(const redis_reply &rr);
+	bool reply_hello(const redis_reply &rr, int protover);
+	bool cache_ready();
+	void cache_drain();
+	bool cache_lookup(const QByteArray &key, const QByteArray &sub, QList<QByteArray> &values);
+	bool cache_lookup(const QList<QByteArray> &keys, QList<QByteArray> &values);
+	quint64 cache_begin();
+	void cache_store(const QByteArray &key, const QByteArray &sub, quint64 since, const redis_reply &rr, const QList<QByteArray> &values);
+	void cache_store(const QList<QByteArray> &keys, quint64 since, const redis_reply &rr, const QList<QByteArray> &values);
+	void cache_track();
+	void send_tracking(qlonglong redirect);
+	void cache_invalidate(const redis_reply &keys);
+	void cache_written(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args);
+	QSharedPointer<redis_hold> hold_pending();
+	static void release_held(redis_hold *hold);
+	redis_reply execute(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args = QList<QByteArray>(), const redis_stream &stream = redis_stream());
+	void send(std::initializer_list<redis_arg> cmd, const redis_callback &callback);
+	void send(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args, const redis_callback &callback, const redis_stream &stream = redis_stream());
+	void send_batch(const redis_writer &batch, int count, const redis_callback &callback);
+	/*
+	 * Forms generated from a command descriptor. Arguments follow the
+	 * command words in order; a trailing QList<QByteArray> is expanded.
+	 */
+	template<class D, class... A> typename D::result_type execute(const redis_command<D> &command, const A &... args)
+	{
+		return reply_as(D(), command.subcommand ? execute({command.name, command.subcommand, args...}) : execute({command.name, args...}));
+	}
+	template<class D, class H> typename D::result_type execute(const redis_command<D> &command, const H &head, const QList<QByteArray> &rest)
+	{
+		return reply_as(D(), command.subcommand ? execute({command.name, command.subcommand, head}, rest) : execute({command.name, head}, rest));
+	}
+	template<class D> typename D::result_type execute(const redis_command<D> &command, const QList<QByteArray> &rest)
+	{
+		return reply_as(D(), command.subcommand ? execute({command.name, command.subcommand}, rest) : execute({command.name}, rest));
+	}
+	template<class D, class... A> void send(const redis_command<D> &command, const typename D::callback_type &callback, const A &... args)
+	{
+		redis_callback decoded = decoder(D(), callback);
+		if (command.subcommand)
+		{
+			send({command.name, command.subcommand, args...}, decoded);
+		}
+		else
+		{
+			send({command.name, args...}, decoded);
+		}
+	}
+	template<class D, class H> void send(const redis_command<D> &command, const typename D::callback_type &callback, const H &head, const QList<QByteArray> &rest)
+	{
+		redis_callback decoded = decoder(D(), callback);
+		if (command.subcommand)
+		{
+			send({command.name, command.subcommand, head}, rest, decoded);
+		}
+		else
+		{
+			send({command.name, head}, rest, decoded);
+		}
+	}
+	template<class D> void send(const redis_command<D> &command, const typename D::callback_type &callback, const QList<QByteArray> &rest)
+	{
+		redis_callback decoded = decoder(D(), callback);
+		if (command.subcommand)
+		{
+			send({command.name, command.subcommand}, rest, decoded);
+		}
+		else
+		{
+			send({command.name}, rest, decoded);
+		}
+	}
+	template<class D> redis_callback decoder(const D &decoding, const typename D::callback_type &callback)
+	{
+		return [this, decoding, callback](const redis_reply &rr)
+		{
+			callback(reply_as(decoding, rr));
+		};
+	}
+	redis_callback decoder(const redis_as_done &decoding, const redis_done_callback &callback);
+	bool wait_for(const std::function<bool ()> &done);
+	int take_timeout();
+	void fail_pending(const QString &error);
+	void connection_lost();
+	void schedule_reconnect();
+	void stop_timers();
+	void replay_session();
+	void reply_check(const redis_reply &rr);
+	bool reply_bool(const redis_reply &rr);
+	qlonglong reply_integer(const redis_reply &rr, qlonglong def);
+	qreal reply_real(const redis_reply &rr);
+	QString reply_string(const redis_reply &rr);
+	QStringList reply_strings(const redis_reply &rr);
+	QStringList reply_script(const redis_reply &rr);
+	QByteArray reply_bytes(const redis_reply &rr);
+	QList<QByteArray> reply_list(const redis_reply &rr);
+	QDateTime reply_time(const redis_reply &rr);
+	void reply_as(const redis_as_done &, const redis_reply &rr) { reply_check(rr); }
+	bool reply_as(const redis_as_bool &, const redis_reply &rr) { return reply_bool(rr); }
+	bool reply_as(const redis_as_status &, const redis_reply &rr);
+	bool reply_as(const redis_as_pong &, const redis_reply &rr) { return reply_string(rr) == "PONG"; }
+	template<int Fallback> qlonglong reply_as(const redis_as_integer<Fallback> &, const redis_reply &rr) { return reply_integer(rr, Fallback); }
+	qreal reply_as(const redis_as_real &, const redis_reply &rr) { return reply_real(rr); }
+	QString reply_as(const redis_as_string &, const redis_reply &rr) { return reply_string(rr); }
+	QByteArray reply_as(const redis_as_bytes &, const redis_reply &rr) { return reply_bytes(rr); }
+	QStringList reply_as(const redis_as_strings &, const redis_reply &rr) { return reply_strings(rr); }
+	QList<QByteArray> reply_as(const redis_as_list &, const redis_reply &rr) { return reply_list(rr); }
+	QStringList reply_as(const redis_as_lines &, const redis_reply &rr);
+	QDateTime reply_as(const redis_as_time &, const redis_reply &rr) { return reply_time(rr); }
 protected:
-	QTcpSocket *m_sock;
-	QTcpSocket *m_subssock;
-	bool m_isconnected;
+	QRedisTransport *m_sock;
+	QRedisTransport *m_subssock;
+	Backend m_backend;
+	redis_parser m_parser;
+	redis_parser m_subsparser;
+	redis_writer m_writer;
+	redis_writer m_subswriter;
+	QTimer *m_flushtimer;
+	QTimer *m_deferredtimer;
+	QQueue<redis_reply> m_deferred;
+	QQueue<redis_reply> m_subsdeferred;
+	bool m_draining;
+	int m_replydepth;
+	int m_batchcount;
+	int m_maxbatchcount;
+	int m_maxbatchbytes;
+	int m_timeout;
+	int m_nexttimeout;
+	bool m_hasnexttimeout;
+	QThread *m_thread;
+	QThread *m_owner;
+	redis_submit_queue m_submissions;
+	std::atomic<quint64> m_nextid;
+	QQueue<redis_pending> m_pending;
+	QQueue<redis_pending> m_offline;
+	QTimer *m_reconnecttimer;
+	int m_reconnectbase;
+	int m_reconnectmax;
+	int m_attempt;
+	int m_offlinelimit;
+	int m_readretries;
+	QByteArray m_password;
+	int m_db;
+	int m_protocol;
+	QByteArray m_clientname;
 	int m_port;
 	QString m_ip;
 	QString m_error;
 	QSet<QString> m_channels, m_pchannels;
+	redis_cache m_cache;
+	bool m_cacheactive;
+	qlonglong m_subsid;
+	QQueue<QByteArray> m_subsrequests;
+	QList<QRedisScript> m_registered;
+};
+
+Q_DECLARE_METATYPE(redis_reply)
+
+typedef std::function<void (const QList<redis_reply> &)> redis_pipeline_callback;
+
+struct redis_pipeline_state
+{
+	QList<redis_reply> replies;
+	QMap<int, QString> errors;
+	QVector<redis_callback> callbacks;
+	int expected;
+};
+
+/*
+ * Explicit pipeline. Commands are encoded as they are added and sent in one
+ * write by exec(), which yields one reply per command in order. A failing
+ * command does not abort the batch: its reply is an error and its index is
+ * listed in errors().
+ */
+class QRedisPipeline
+{
+public:
+	QRedisPipeline(QRedis *redis);
+	void add(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args = QList<QByteArray>());
+	void add(const QList<QByteArray> &cmd);
+	/*
+	 * Pipelined form of a command from the table; callback is given the
+	 * decoded reply once the batch is answered, before exec() returns.
+	 */
+	template<class D, class... A> void add(const redis_command<D> &command, const typename D::callback_type &callback, const A &... args)
+	{
+		if (command.subcommand)
+		{
+			add({command.name, command.subcommand, args...});
+		}
+		else
+		{
+			add({command.name, args...});
+		}
+		m_callbacks.last() = m_redis->decoder(D(), callback);
+	}
+	template<class D, class H> void add(const redis_command<D> &command, const typename D::callback_type &callback, const H &head, const QList<QByteArray> &rest)
+	{
+		if (command.subcommand)
+		{
+			add({command.name, command.subcommand, head}, rest);
+		}
+		else
+		{
+			add({command.name, head}, rest);
+		}
+		m_callbacks.last() = m_redis->decoder(D(), callback);
+	}
+	template<class D> void add(const redis_command<D> &command, const typename D::callback_type &callback, const QList<QByteArray> &rest)
+	{
+		if (command.subcommand)
+		{
+			add({command.name, command.subcommand}, rest);
+		}
+		else
+		{
+			add({command.name}, rest);
+		}
+		m_callbacks.last() = m_redis->decoder(D(), callback);
+	}
+	int count() const;
+	void clear();
+	QList<redis_reply> exec();
+	void exec(const redis_pipeline_callback &callback);
+	bool hasErrors() const;
+	QMap<int, QString> errors() const;
+private:
+	QSharedPointer<redis_pipeline_state> start(const redis_pipeline_callback &callback);
+private:
+	QRedis *m_redis;
+	redis_writer m_writer;
+	int m_count;
+	QVector<redis_callback> m_callbacks;
+	QSharedPointer<redis_pipeline_state> m_state;
+};
+
+typedef std::function<void (const QList<redis_reply> &)> redis_transaction_callback;
+
+struct redis_transaction_state
+{
+	redis_transaction_state() : aborted(false) {}
+	QList<redis_reply> results;
+	QMap<int, QString> queueErrors;
+	QMap<int, QString> errors;
+	QVector<redis_callback> callbacks;
+	QString error;
+	bool aborted;
+};
+
+/*
+ * MULTI/EXEC transaction. MULTI, the queued commands and EXEC go out in a
+ * single pipelined write; exec() yields the EXEC array, one reply per
+ * queued command, and a command added from the command table has its
+ * element decoded into its callback. Keys are watched with QRedis::watch()
+ * before the transaction is built. Nothing reaches the server before
+ * exec(), so clear() only drops the queued commands.
+ * aborted() is set when a WATCHed key changed or a command was rejected at
+ * queue time, the latter listed in queueErrors(); errors() lists commands
+ * that failed inside EXEC. A timeout or connection loss is reported by
+ * error() instead, and then it is unknown whether EXEC ran. Without
+ * results, typed callbacks get their default value.
+ */
+class QRedisTransaction
+{
+public:
+	QRedisTransaction(QRedis *redis);
+	void add(std::initializer_list<redis_arg> cmd, const QList<QByteArray> &args = QList<QByteArray>());
+	void add(const QList<QByteArray> &cmd);
+	template<class D, class... A> void add(const redis_command<D> &command, const typename D::callback_type &callback, const A &... args)
+	{
+		if (command.subcommand)
+		{
+			add({command.name, command.subcommand, args...});
+		}
+		else
+		{
+			add({command.name, args...});
+		}
+		m_callbacks.last() = m_redis->decoder(D(), callback);
+	}
+	template<class D, class H> void add(const redis_command<D> &command, const typename D::callback_type &callback, const H &head, const QList<QByteArray> &rest)
+	{
+		if (command.subcommand)
+		{
+			add({command.name, command.subcommand, head}, rest);
+		}
+		else
+		{
+			add({command.name, head}, rest);
+		}
+		m_callbacks.last() = m_redis->decoder(D(), callback);
+	}
+	template<class D> void add(const redis_command<D> &command, const typename D::callback_type &callback, const QList<QByteArray> &rest)
+	{
+		if (command.subcommand)
+		{
+			add({command.name, command.subcommand}, rest);
+		}
+		else
+		{
+			add({command.name}, rest);
+		}
+		m_callbacks.last() = m_redis->decoder(D(), callback);
+	}
+	int count() const;
+	void clear();
+	QList<redis_reply> exec();
+	void exec(const redis_transaction_callback &callback);
+	bool aborted() const;
+	QString error() const;
+	bool hasErrors() const;
+	QMap<int, QString> queueErrors() const;
+	QMap<int, QString> errors() const;
+private:
+	QSharedPointer<redis_transaction_state> start();
+	static void decode(redis_transaction_state *state, const QList<redis_reply> &replies);
+	static void fail(redis_transaction_state *state, const QString &message);
+private:
+	QRedis *m_redis;
+	QRedisPipeline m_pipeline;
+	QVector<redis_callback> m_callbacks;
+	QSharedPointer<redis_transaction_state> m_state;
 };
 
 #endif //_QREDIS_H_
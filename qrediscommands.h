@@ -0,0 +1,120 @@
+#ifndef _QREDISCOMMANDS_H_
+#define _QREDISCOMMANDS_H_
+
+#include "qredis.h"
+
+/*
+ * Command table. Each descriptor gives the words of a command and the type
+ * its reply is decoded to; QRedis generates its blocking and asynchronous
+ * forms from it, QRedisPipeline::add() takes it for the pipelined one:
+ * pipeline.add(redis_commands::incr, callback, "counter"), and
+ * QRedisCoro::run() for the awaitable one.
+ *
+ * Commands whose reply is not simply decoded stay hand-written in QRedis:
+ * get, mget, hget and hgetall, which go through the local cache; the
+ * forms that stream a reply to a visitor or a QIODevice; eval, which
+ * retries on NOSCRIPT; hello, which switches the protocol; and subscribe
+ * and its kin, which are sent on the subscriber connection. get, mget,
+ * hget and hgetall also have descriptors here, for their plain uncached
+ * forms in pipelines and transactions.
+ */
+namespace redis_commands
+{
+	///////////////////////key//////////////////////////////
+	constexpr redis_command<redis_as_integer<0> > del = {"del", 0};
+	constexpr redis_command<redis_as_bool> exists = {"exists", 0};
+	constexpr redis_command<redis_as_bool> expire = {"expire", 0};
+	constexpr redis_command<redis_as_bool> expireat = {"expireat", 0};
+	constexpr redis_command<redis_as_strings> keys = {"keys", 0};
+	constexpr redis_command<redis_as_bool> move = {"move", 0};
+	constexpr redis_command<redis_as_bool> persist = {"persist", 0};
+	constexpr redis_command<redis_as_bool> pexpire = {"pexpire", 0};
+	constexpr redis_command<redis_as_bool> pexpireat = {"pexpireat", 0};
+	constexpr redis_command<redis_as_integer<0> > pttl = {"pttl", 0};
+	constexpr redis_command<redis_as_string> randomkey = {"randomkey", 0};
+	constexpr redis_command<redis_as_bool> rename = {"rename", 0};
+	constexpr redis_command<redis_as_bool> renamenx = {"renamenx", 0};
+	constexpr redis_command<redis_as_integer<0> > ttl = {"ttl", 0};
+	constexpr redis_command<redis_as_string> type = {"type", 0};
+	///////////////////////string//////////////////////////////
+	constexpr redis_command<redis_as_integer<0> > append = {"append", 0};
+	constexpr redis_command<redis_as_integer<-9999> > decr = {"decr", 0};
+	constexpr redis_command<redis_as_integer<-9999> > decrby = {"decrby", 0};
+	constexpr redis_command<redis_as_bytes> get = {"get", 0};
+	constexpr redis_command<redis_as_bytes> getrange = {"getrange", 0};
+	constexpr redis_command<redis_as_bytes> getset = {"getset", 0};
+	constexpr redis_command<redis_as_integer<-9999> > incr = {"incr", 0};
+	constexpr redis_command<redis_as_integer<-9999> > incrby = {"incrby", 0};
+	constexpr redis_command<redis_as_real> incrbyfloat = {"incrbyfloat", 0};
+	constexpr redis_command<redis_as_list> mget = {"mget", 0};
+	constexpr redis_command<redis_as_done> mset = {"mset", 0};
+	constexpr redis_command<redis_as_bool> msetnx = {"msetnx", 0};
+	constexpr redis_command<redis_as_bool> psetex = {"psetex", 0};
+	constexpr redis_command<redis_as_bool> set = {"set", 0};
+	constexpr redis_command<redis_as_bool> setex = {"setex", 0};
+	constexpr redis_command<redis_as_bool> setnx = {"setnx", 0};
+	constexpr redis_command<redis_as_integer<0> > setrange = {"setrange", 0};
+	constexpr redis_command<redis_as_integer<0> > strlen = {"strlen", 0};
+	///////////////////////hash//////////////////////////////
+	constexpr redis_command<redis_as_integer<0> > hdel = {"hdel", 0};
+	constexpr redis_command<redis_as_bool> hexists = {"hexists", 0};
+	constexpr redis_command<redis_as_bytes> hget = {"hget", 0};
+	constexpr redis_command<redis_as_list> hgetall = {"hgetall", 0};
+	constexpr redis_command<redis_as_integer<-9999> > hincrby = {"hincrby", 0};
+	constexpr redis_command<redis_as_real> hincrbyfloat = {"hincrbyfloat", 0};
+	constexpr redis_command<redis_as_list> hkeys = {"hkeys", 0};
+	constexpr redis_command<redis_as_integer<-9999> > hlen = {"hlen", 0};
+	constexpr redis_command<redis_as_list> hmget = {"hmget", 0};
+	constexpr redis_command<redis_as_bool> hmset = {"hmset", 0};
+	constexpr redis_command<redis_as_integer<-1> > hset = {"hset", 0};
+	constexpr redis_command<redis_as_bool> hsetnx = {"hsetnx", 0};
+	constexpr redis_command<redis_as_list> hvals = {"hvals", 0};
+	///////////////////////list//////////////////////////////
+	constexpr redis_command<redis_as_bytes> lindex = {"lindex", 0};
+	constexpr redis_command<redis_as_integer<0> > llen = {"llen", 0};
+	constexpr redis_command<redis_as_bytes> lpop = {"lpop", 0};
+	constexpr redis_command<redis_as_integer<0> > lpush = {"lpush", 0};
+	constexpr redis_command<redis_as_list> lrange = {"lrange", 0};
+	constexpr redis_command<redis_as_integer<0> > lrem = {"lrem", 0};
+	constexpr redis_command<redis_as_bool> lset = {"lset", 0};
+	constexpr redis_command<redis_as_bytes> rpop = {"rpop", 0};
+	constexpr redis_command<redis_as_integer<0> > rpush = {"rpush", 0};
+	///////////////////////set//////////////////////////////
+	constexpr redis_command<redis_as_integer<0> > sadd = {"sadd", 0};
+	constexpr redis_command<redis_as_integer<0> > scard = {"scard", 0};
+	constexpr redis_command<redis_as_list> sdiff = {"sdiff", 0};
+	constexpr redis_command<redis_as_list> sinter = {"sinter", 0};
+	constexpr redis_command<redis_as_bool> sismember = {"sismember", 0};
+	constexpr redis_command<redis_as_list> smembers = {"smembers", 0};
+	constexpr redis_command<redis_as_integer<0> > srem = {"srem", 0};
+	constexpr redis_command<redis_as_list> sunion = {"sunion", 0};
+	///////////////////////pub/sub//////////////////////////////
+	constexpr redis_command<redis_as_integer<0> > publish = {"publish", 0};
+	///////////////////////transaction//////////////////////////////
+	constexpr redis_command<redis_as_bool> watch = {"watch", 0};
+	constexpr redis_command<redis_as_bool> unwatch = {"unwatch", 0};
+	///////////////////////script//////////////////////////////
+	constexpr redis_command<redis_as_bool> script_exists = {"script", "exists"};
+	constexpr redis_command<redis_as_strings> script_exists_all = {"script", "exists"};
+	constexpr redis_command<redis_as_done> script_flush = {"script", "flush"};
+	constexpr redis_command<redis_as_done> script_kill = {"script", "kill"};
+	constexpr redis_command<redis_as_string> script_load = {"script", "load"};
+	///////////////////////connection//////////////////////////////
+	constexpr redis_command<redis_as_bool> auth = {"auth", 0};
+	constexpr redis_command<redis_as_pong> ping = {"ping", 0};
+	constexpr redis_command<redis_as_done> quit = {"quit", 0};
+	constexpr redis_command<redis_as_bool> select = {"select", 0};
+	///////////////////////server//////////////////////////////
+	constexpr redis_command<redis_as_status> bgsave = {"bgsave", 0};
+	constexpr redis_command<redis_as_string> client_getname = {"client", "getname"};
+	constexpr redis_command<redis_as_bool> client_kill = {"client", "kill"};
+	constexpr redis_command<redis_as_lines> client_list = {"client", "list"};
+	constexpr redis_command<redis_as_bool> client_setname = {"client", "setname"};
+	constexpr redis_command<redis_as_integer<0> > dbsize = {"dbsize", 0};
+	constexpr redis_command<redis_as_done> flushall = {"flushall", 0};
+	constexpr redis_command<redis_as_done> flushdb = {"flushdb", 0};
+	constexpr redis_command<redis_as_string> info = {"info", 0};
+	constexpr redis_command<redis_as_time> time = {"time", 0};
+}
+
+#endif //_QREDISCOMMANDS_H_
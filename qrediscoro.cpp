@@ -0,0 +1,237 @@
+#include "qrediscoro.h"
+
+#if defined(__cpp_impl_coroutine)
+
+redis_awaitable<redis_reply> QRedisCoro::command(const QList<QByteArray> &cmd)
+{
+	return redis_awaitable<redis_reply>([this, cmd](const redis_callback &resume)
+	{
+		m_redis->command(cmd, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::get(const QString &key, QIODevice *sink)
+{
+	return redis_awaitable<qlonglong>([this, key, sink](const redis_integer_callback &resume)
+	{
+		m_redis->get(key, sink, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::getRaw(const QByteArray &key, QIODevice *sink)
+{
+	return redis_awaitable<qlonglong>([this, key, sink](const redis_integer_callback &resume)
+	{
+		m_redis->getRaw(key, sink, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::getrange(const QString &key, qlonglong start, qlonglong stop, QIODevice *sink)
+{
+	return redis_awaitable<qlonglong>([this, key, start, stop, sink](const redis_integer_callback &resume)
+	{
+		m_redis->getrange(key, start, stop, sink, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::getrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop, QIODevice *sink)
+{
+	return redis_awaitable<qlonglong>([this, key, start, stop, sink](const redis_integer_callback &resume)
+	{
+		m_redis->getrangeRaw(key, start, stop, sink, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::hgetallEach(const QString &key, const redis_string_pair_callback &visitor)
+{
+	return redis_awaitable<qlonglong>([this, key, visitor](const redis_integer_callback &resume)
+	{
+		m_redis->hgetallEach(key, visitor, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::hgetallEachRaw(const QByteArray &key, const redis_bytes_pair_callback &visitor)
+{
+	return redis_awaitable<qlonglong>([this, key, visitor](const redis_integer_callback &resume)
+	{
+		m_redis->hgetallEachRaw(key, visitor, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::hkeysEach(const QString &key, const redis_string_callback &visitor)
+{
+	return redis_awaitable<qlonglong>([this, key, visitor](const redis_integer_callback &resume)
+	{
+		m_redis->hkeysEach(key, visitor, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::hkeysEachRaw(const QByteArray &key, const redis_bytes_callback &visitor)
+{
+	return redis_awaitable<qlonglong>([this, key, visitor](const redis_integer_callback &resume)
+	{
+		m_redis->hkeysEachRaw(key, visitor, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::hvalsEach(const QString &key, const redis_string_callback &visitor)
+{
+	return redis_awaitable<qlonglong>([this, key, visitor](const redis_integer_callback &resume)
+	{
+		m_redis->hvalsEach(key, visitor, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::hvalsEachRaw(const QByteArray &key, const redis_bytes_callback &visitor)
+{
+	return redis_awaitable<qlonglong>([this, key, visitor](const redis_integer_callback &resume)
+	{
+		m_redis->hvalsEachRaw(key, visitor, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::lrangeEach(const QString &key, qlonglong start, qlonglong stop, const redis_string_callback &visitor)
+{
+	return redis_awaitable<qlonglong>([this, key, start, stop, visitor](const redis_integer_callback &resume)
+	{
+		m_redis->lrangeEach(key, start, stop, visitor, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::lrangeEachRaw(const QByteArray &key, qlonglong start, qlonglong stop, const redis_bytes_callback &visitor)
+{
+	return redis_awaitable<qlonglong>([this, key, start, stop, visitor](const redis_integer_callback &resume)
+	{
+		m_redis->lrangeEachRaw(key, start, stop, visitor, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::smembersEach(const QString &key, const redis_string_callback &visitor)
+{
+	return redis_awaitable<qlonglong>([this, key, visitor](const redis_integer_callback &resume)
+	{
+		m_redis->smembersEach(key, visitor, resume);
+	});
+}
+
+redis_awaitable<qlonglong> QRedisCoro::smembersEachRaw(const QByteArray &key, const redis_bytes_callback &visitor)
+{
+	return redis_awaitable<qlonglong>([this, key, visitor](const redis_integer_callback &resume)
+	{
+		m_redis->smembersEachRaw(key, visitor, resume);
+	});
+}
+
+redis_awaitable<QString> QRedisCoro::get(const QString &key)
+{
+	return redis_awaitable<QString>([this, key](const redis_string_callback &resume)
+	{
+		m_redis->get(key, resume);
+	});
+}
+
+redis_awaitable<QByteArray> QRedisCoro::getRaw(const QByteArray &key)
+{
+	return redis_awaitable<QByteArray>([this, key](const redis_bytes_callback &resume)
+	{
+		m_redis->getRaw(key, resume);
+	});
+}
+
+redis_awaitable<QStringList> QRedisCoro::mget(const QStringList &keys)
+{
+	return redis_awaitable<QStringList>([this, keys](const redis_string_list_callback &resume)
+	{
+		m_redis->mget(keys, resume);
+	});
+}
+
+redis_awaitable<QList<QByteArray>> QRedisCoro::mgetRaw(const QList<QByteArray> &keys)
+{
+	return redis_awaitable<QList<QByteArray>>([this, keys](const redis_bytes_list_callback &resume)
+	{
+		m_redis->mgetRaw(keys, resume);
+	});
+}
+
+redis_awaitable<QString> QRedisCoro::hget(const QString &key, const QString &field)
+{
+	return redis_awaitable<QString>([this, key, field](const redis_string_callback &resume)
+	{
+		m_redis->hget(key, field, resume);
+	});
+}
+
+redis_awaitable<QByteArray> QRedisCoro::hgetRaw(const QByteArray &key, const QByteArray &field)
+{
+	return redis_awaitable<QByteArray>([this, key, field](const redis_bytes_callback &resume)
+	{
+		m_redis->hgetRaw(key, field, resume);
+	});
+}
+
+redis_awaitable<QStringList> QRedisCoro::hgetall(const QString &key)
+{
+	return redis_awaitable<QStringList>([this, key](const redis_string_list_callback &resume)
+	{
+		m_redis->hgetall(key, resume);
+	});
+}
+
+redis_awaitable<QList<QByteArray>> QRedisCoro::hgetallRaw(const QByteArray &key)
+{
+	return redis_awaitable<QList<QByteArray>>([this, key](const redis_bytes_list_callback &resume)
+	{
+		m_redis->hgetallRaw(key, resume);
+	});
+}
+
+redis_awaitable<QStringList> QRedisCoro::eval(const QString &script, const QStringList &args)
+{
+	return redis_awaitable<QStringList>([this, script, args](const redis_string_list_callback &resume)
+	{
+		m_redis->eval(script, args, resume);
+	});
+}
+
+redis_awaitable<QStringList> QRedisCoro::eval(const QRedisScript &script, const QStringList &args)
+{
+	return redis_awaitable<QStringList>([this, script, args](const redis_string_list_callback &resume)
+	{
+		m_redis->eval(script, args, resume);
+	});
+}
+
+redis_awaitable<redis_reply> QRedisCoro::evalRaw(const QRedisScript &script, const QList<QByteArray> &args)
+{
+	return redis_awaitable<redis_reply>([this, script, args](const redis_callback &resume)
+	{
+		m_redis->evalRaw(script, args, resume);
+	});
+}
+
+redis_awaitable<QStringList> QRedisCoro::evalsha(const QString &sha1, const QStringList &args)
+{
+	return redis_awaitable<QStringList>([this, sha1, args](const redis_string_list_callback &resume)
+	{
+		m_redis->evalsha(sha1, args, resume);
+	});
+}
+
+redis_awaitable<redis_reply> QRedisCoro::evalshaRaw(const QByteArray &sha1, const QList<QByteArray> &args)
+{
+	return redis_awaitable<redis_reply>([this, sha1, args](const redis_callback &resume)
+	{
+		m_redis->evalshaRaw(sha1, args, resume);
+	});
+}
+
+redis_awaitable<bool> QRedisCoro::hello(int protover)
+{
+	return redis_awaitable<bool>([this, protover](const redis_bool_callback &resume)
+	{
+		m_redis->hello(protover, resume);
+	});
+}
+
+#endif //__cpp_impl_coroutine
@@ -0,0 +1,149 @@
+#ifndef _QREDISCORO_H_
+#define _QREDISCORO_H_
+
+#include "qrediscommands.h"
+
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <exception>
+
+/*
+ * Awaitable result of a command issued through QRedisCoro. The coroutine
+ * suspends until the reply is taken off the pending queue in readyRead
+ * handling and is resumed from there, inside the Qt event loop.
+ */
+template<typename T>
+class redis_awaitable
+{
+public:
+	typedef std::function<void (const T &)> resume_t;
+	explicit redis_awaitable(const std::function<void (const resume_t &)> &start) : m_start(start), m_done(false), m_suspended(false) {}
+	bool await_ready() const { return false; }
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		m_handle = handle;
+		m_start([this](const T &value)
+		{
+			m_value = value;
+			m_done = true;
+			if (m_suspended) m_handle.resume();
+		});
+
+		// a command that fails before it is sent completes right away
+		m_suspended = !m_done;
+		return m_suspended;
+	}
+	T await_resume() { return m_value; }
+private:
+	std::function<void (const resume_t &)> m_start;
+	std::coroutine_handle<> m_handle;
+	T m_value;
+	bool m_done;
+	bool m_suspended;
+};
+
+template<>
+class redis_awaitable<void>
+{
+public:
+	typedef std::function<void ()> resume_t;
+	explicit redis_awaitable(const std::function<void (const resume_t &)> &start) : m_start(start), m_done(false), m_suspended(false) {}
+	bool await_ready() const { return false; }
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		m_handle = handle;
+		m_start([this]()
+		{
+			m_done = true;
+			if (m_suspended) m_handle.resume();
+		});
+
+		m_suspended = !m_done;
+		return m_suspended;
+	}
+	void await_resume() {}
+private:
+	std::function<void (const resume_t &)> m_start;
+	std::coroutine_handle<> m_handle;
+	bool m_done;
+	bool m_suspended;
+};
+
+/*
+ * Fire-and-forget coroutine type for code that has no task type of its own:
+ * redis_task handler(QRedisCoro redis) { QString v = co_await redis.get("k"); ... }
+ */
+struct redis_task
+{
+	struct promise_type
+	{
+		redis_task get_return_object() { return redis_task(); }
+		std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+		std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+/*
+ * Awaitable front for a QRedis. run() takes any command of the table in
+ * qrediscommands.h and yields its reply decoded as the descriptor says:
+ * qlonglong n = co_await redis.run(redis_commands::incr, "counter").
+ * The commands the table leaves out have awaitables of their own.
+ */
+class QRedisCoro
+{
+public:
+	QRedisCoro(QRedis *redis) : m_redis(redis) {}
+public:
+	template<class D, class... A> redis_awaitable<typename D::result_type> run(const redis_command<D> &command, const A &... args)
+	{
+		typedef redis_awaitable<typename D::result_type> awaitable;
+		QRedis *redis = m_redis;
+		return awaitable([redis, command, args...](const typename awaitable::resume_t &resume)
+		{
+			redis->send(command, typename D::callback_type(resume), args...);
+		});
+	}
+	///////////////////////generic//////////////////////////////
+	redis_awaitable<redis_reply> command(const QList<QByteArray> &cmd);
+	///////////////////////streaming//////////////////////////////
+	redis_awaitable<qlonglong> get(const QString &key, QIODevice *sink);
+	redis_awaitable<qlonglong> getRaw(const QByteArray &key, QIODevice *sink);
+	redis_awaitable<qlonglong> getrange(const QString &key, qlonglong start, qlonglong stop, QIODevice *sink);
+	redis_awaitable<qlonglong> getrangeRaw(const QByteArray &key, qlonglong start, qlonglong stop, QIODevice *sink);
+	redis_awaitable<qlonglong> hgetallEach(const QString &key, const redis_string_pair_callback &visitor);
+	redis_awaitable<qlonglong> hgetallEachRaw(const QByteArray &key, const redis_bytes_pair_callback &visitor);
+	redis_awaitable<qlonglong> hkeysEach(const QString &key, const redis_string_callback &visitor);
+	redis_awaitable<qlonglong> hkeysEachRaw(const QByteArray &key, const redis_bytes_callback &visitor);
+	redis_awaitable<qlonglong> hvalsEach(const QString &key, const redis_string_callback &visitor);
+	redis_awaitable<qlonglong> hvalsEachRaw(const QByteArray &key, const redis_bytes_callback &visitor);
+	redis_awaitable<qlonglong> lrangeEach(const QString &key, qlonglong start, qlonglong stop, const redis_string_callback &visitor);
+	redis_awaitable<qlonglong> lrangeEachRaw(const QByteArray &key, qlonglong start, qlonglong stop, const redis_bytes_callback &visitor);
+	redis_awaitable<qlonglong> smembersEach(const QString &key, const redis_string_callback &visitor);
+	redis_awaitable<qlonglong> smembersEachRaw(const QByteArray &key, const redis_bytes_callback &visitor);
+	///////////////////////cached//////////////////////////////
+	redis_awaitable<QString> get(const QString &key);
+	redis_awaitable<QByteArray> getRaw(const QByteArray &key);
+	redis_awaitable<QStringList> mget(const QStringList &keys);
+	redis_awaitable<QList<QByteArray>> mgetRaw(const QList<QByteArray> &keys);
+	redis_awaitable<QString> hget(const QString &key, const QString &field);
+	redis_awaitable<QByteArray> hgetRaw(const QByteArray &key, const QByteArray &field);
+	redis_awaitable<QStringList> hgetall(const QString &key);
+	redis_awaitable<QList<QByteArray>> hgetallRaw(const QByteArray &key);
+	///////////////////////script//////////////////////////////
+	redis_awaitable<QStringList> eval(const QString &script, const QStringList &args);
+	redis_awaitable<QStringList> eval(const QRedisScript &script, const QStringList &args);
+	redis_awaitable<redis_reply> evalRaw(const QRedisScript &script, const QList<QByteArray> &args);
+	redis_awaitable<QStringList> evalsha(const QString &sha1, const QStringList &args);
+	redis_awaitable<redis_reply> evalshaRaw(const QByteArray &sha1, const QList<QByteArray> &args);
+	///////////////////////connection//////////////////////////////
+	redis_awaitable<bool> hello(int protover = 3);
+private:
+	QRedis *m_redis;
+};
+
+#endif //__cpp_impl_coroutine
+
+#endif //_QREDISCORO_H_
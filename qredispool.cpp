@@ -0,0 +1,230 @@
+#include <QThread>
+#include <QTimer>
+#include <limits.h>
+#include "qredispool.h"
+
+static const int POOL_MAINTENANCE_INTERVAL = 1000;
+static const int POOL_RETRY_INTERVAL = 100;
+
+QRedisPool::QRedisPool(const QString &host, quint16 port, int minSize, int maxSize, QObject *parent)
+	: QObject(parent), m_host(host), m_port(port), m_minsize(minSize), m_maxsize(qMax(minSize, maxSize)),
+	  m_idletimeout(60000), m_healthinterval(5000), m_size(0)
+{
+	for (int i = 0; i < m_minsize; i++)
+	{
+		QRedis *redis = create();
+		if (!redis) break;
+
+		m_size++;
+		redis_pool_entry entry;
+		entry.redis = redis;
+		entry.idle.start();
+		entry.checked.start();
+		park(entry);
+	}
+
+	m_timer = new QTimer(this);
+	connect(m_timer, SIGNAL(timeout()), this, SLOT(maintain()));
+	m_timer->start(POOL_MAINTENANCE_INTERVAL);
+}
+
+QRedisPool::~QRedisPool()
+{
+	// leased connections are owned by their holders until released
+	foreach (const redis_pool_entry &entry, m_idle)
+	{
+		unpark(entry.redis);
+		delete entry.redis;
+	}
+}
+
+void QRedisPool::setIdleTimeout(int msecs)
+{
+	QMutexLocker locker(&m_mutex);
+	m_idletimeout = msecs;
+}
+
+void QRedisPool::setHealthCheckInterval(int msecs)
+{
+	QMutexLocker locker(&m_mutex);
+	m_healthinterval = msecs;
+}
+
+QRedis *QRedisPool::acquire(int msecs)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	QMutexLocker locker(&m_mutex);
+	forever
+	{
+		int wait = -1;
+		if (!m_idle.isEmpty())
+		{
+			// most recently used first, so surplus connections age out
+			redis_pool_entry entry = m_idle.takeLast();
+			bool stale = entry.checked.elapsed() >= m_healthinterval;
+			locker.unlock();
+
+			unpark(entry.redis);
+			if (!stale || entry.redis->ping()) return entry.redis;
+
+			discard(entry.redis);
+			locker.relock();
+			continue;
+		}
+
+		if (m_size < m_maxsize)
+		{
+			m_size++;
+			locker.unlock();
+
+			QRedis *redis = create();
+			if (redis) return redis;
+
+			// the server may come back before the deadline
+			locker.relock();
+			m_size--;
+			m_released.wakeOne();
+			wait = POOL_RETRY_INTERVAL;
+		}
+
+		int remaining = msecs < 0 ? -1 : msecs - int(timer.elapsed());
+		if (msecs >= 0 && remaining <= 0) return 0;
+		if (wait < 0 || (remaining >= 0 && remaining < wait)) wait = remaining;
+		m_released.wait(&m_mutex, wait < 0 ? ULONG_MAX : wait);
+	}
+}
+
+void QRedisPool::release(QRedis *redis)
+{
+	if (!redis) return;
+
+	if (!redis->isConnected())
+	{
+		discard(redis);
+		return;
+	}
+
+	redis_pool_entry entry;
+	entry.redis = redis;
+	entry.idle.start();
+	entry.checked.start();
+	park(entry);
+}
+
+int QRedisPool::size() const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_size;
+}
+
+int QRedisPool::idleCount() const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_idle.count();
+}
+
+void QRedisPool::maintain()
+{
+	QList<redis_pool_entry> expired;
+	QList<redis_pool_entry> stale;
+	{
+		QMutexLocker locker(&m_mutex);
+		int surplus = m_size - m_minsize;
+		for (int i = 0; i < m_idle.count(); )
+		{
+			// m_idle is ordered oldest first
+			const redis_pool_entry &entry = m_idle.at(i);
+			if (surplus > 0 && entry.idle.elapsed() >= m_idletimeout)
+			{
+				expired << m_idle.takeAt(i);
+				surplus--;
+			}
+			else if (entry.checked.elapsed() >= m_healthinterval)
+			{
+				stale << m_idle.takeAt(i);
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+
+	foreach (const redis_pool_entry &entry, expired)
+	{
+		unpark(entry.redis);
+		discard(entry.redis);
+	}
+
+	foreach (redis_pool_entry entry, stale)
+	{
+		unpark(entry.redis);
+		if (!entry.redis->ping())
+		{
+			discard(entry.redis);
+			continue;
+		}
+
+		// still idle since it was released, only the check is new
+		entry.checked.start();
+		park(entry);
+	}
+}
+
+QRedis *QRedisPool::create()
+{
+	QRedis *redis = new QRedis;
+	redis->connectHost(m_host, m_port);
+	if (!redis->isConnected())
+	{
+		delete redis;
+		return 0;
+	}
+	return redis;
+}
+
+void QRedisPool::park(const redis_pool_entry &entry)
+{
+	// drop the thread affinity so that the next acquire() can pull it; its
+	// timers could not be stopped or run without a thread
+	entry.redis->stop_timers();
+	entry.redis->moveToThread(0);
+
+	QMutexLocker locker(&m_mutex);
+	int i = m_idle.count();
+	while (i > 0 && m_idle.at(i - 1).idle.elapsed() < entry.idle.elapsed())
+	{
+		i--;
+	}
+	m_idle.insert(i, entry);
+	m_released.wakeOne();
+}
+
+void QRedisPool::unpark(QRedis *redis)
+{
+	// a connection without thread affinity can only be pulled by the thread that takes it
+	redis->moveToThread(QThread::currentThread());
+}
+
+void QRedisPool::discard(QRedis *redis)
+{
+	// it belongs to the calling thread, which may have no event loop to
+	// run a deleteLater(); outside the lock
+	delete redis;
+
+	QMutexLocker locker(&m_mutex);
+	m_size--;
+	m_released.wakeOne();
+}
+
+QRedisLease::QRedisLease(QRedisPool *pool, int msecs) : m_pool(pool)
+{
+	m_redis = m_pool->acquire(msecs);
+}
+
+QRedisLease::~QRedisLease()
+{
+	m_pool->release(m_redis);
+}
@@ -0,0 +1,84 @@
+#ifndef _QREDISPOOL_H_
+#define _QREDISPOOL_H_
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include "qredis.h"
+
+struct redis_pool_entry
+{
+	QRedis *redis;
+	QElapsedTimer idle;
+	QElapsedTimer checked;
+};
+
+class QTimer;
+
+/*
+ * Thread-safe pool of connections to one server. acquire() leases a
+ * connection to the calling thread, which may use the whole blocking API
+ * on it until release(); while no connection can be opened it keeps
+ * retrying until its deadline. Idle connections are parked without thread
+ * affinity and with their timers stopped. A timer in the thread that
+ * created the pool, which needs an event loop, pings the ones idle for
+ * the health check interval and closes those idle for the idle timeout
+ * while the pool is above its minimum size; acquire() pings a connection
+ * the timer has not checked yet before handing it out.
+ */
+class QRedisPool : public QObject
+{
+	Q_OBJECT
+public:
+	QRedisPool(const QString &host, quint16 port = 6379, int minSize = 0, int maxSize = 8, QObject *parent = 0);
+	~QRedisPool();
+public:
+	void setIdleTimeout(int msecs);
+	void setHealthCheckInterval(int msecs);
+	QRedis *acquire(int msecs = -1);
+	void release(QRedis *redis);
+	int size() const;
+	int idleCount() const;
+private slots:
+	void maintain();
+private:
+	QRedis *create();
+	void park(const redis_pool_entry &entry);
+	void unpark(QRedis *redis);
+	void discard(QRedis *redis);
+private:
+	Q_DISABLE_COPY(QRedisPool)
+	QString m_host;
+	quint16 m_port;
+	int m_minsize;
+	int m_maxsize;
+	int m_idletimeout;
+	int m_healthinterval;
+	int m_size;
+	QList<redis_pool_entry> m_idle;
+	QTimer *m_timer;
+	mutable QMutex m_mutex;
+	QWaitCondition m_released;
+};
+
+/*
+ * Scoped lease: acquires on construction and releases on destruction.
+ */
+class QRedisLease
+{
+public:
+	QRedisLease(QRedisPool *pool, int msecs = -1);
+	~QRedisLease();
+public:
+	bool isValid() const { return m_redis != 0; }
+	QRedis *get() const { return m_redis; }
+	QRedis *operator->() const { return m_redis; }
+private:
+	Q_DISABLE_COPY(QRedisLease)
+	QRedisPool *m_pool;
+	QRedis *m_redis;
+};
+
+#endif //_QREDISPOOL_H_
@@ -0,0 +1,1378 @@
+#include <QTcpSocket>
+#include <QLocalSocket>
+#include <QSocketNotifier>
+#include <QElapsedTimer>
+#include "qredistransport.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+#ifdef QREDIS_HAVE_LIBURING
+#include <QTimer>
+#include <QEvent>
+#include <sys/eventfd.h>
+#include <liburing.h>
+#endif
+
+QRedisTransport::QRedisTransport(QObject *parent) : QObject(parent)
+{
+
+}
+
+QRedisTransport::~QRedisTransport()
+{
+}
+
+qint64 QRedisTransport::writev(const QList<QByteArray> &chunks)
+{
+	qint64 total = 0;
+	foreach (const QByteArray &chunk, chunks)
+	{
+		if (write(chunk.constData(), chunk.size()) < 0) return -1;
+		total += chunk.size();
+	}
+	return total;
+}
+
+QRedisTcpTransport::QRedisTcpTransport(const QString &host, quint16 port, QObject *parent) : QRedisTransport(parent), m_host(host), m_port(port)
+{
+	m_sock = new QTcpSocket(this);
+	connect(m_sock, SIGNAL(readyRead()), this, SIGNAL(readyRead()));
+	connect(m_sock, SIGNAL(connected()), this, SIGNAL(connected()));
+	connect(m_sock, SIGNAL(disconnected()), this, SIGNAL(disconnected()));
+	connect(m_sock, SIGNAL(error(QAbstractSocket::SocketError)), this, SIGNAL(error()));
+}
+
+void QRedisTcpTransport::open()
+{
+	m_sock->connectToHost(m_host, m_port);
+}
+
+bool QRedisTcpTransport::waitForConnected(int msecs)
+{
+	return m_sock->waitForConnected(msecs);
+}
+
+void QRedisTcpTransport::close()
+{
+	m_sock->close();
+}
+
+bool QRedisTcpTransport::isConnected() const
+{
+	return m_sock->state() == QAbstractSocket::ConnectedState;
+}
+
+bool QRedisTcpTransport::isConnecting() const
+{
+	return m_sock->state() == QAbstractSocket::HostLookupState || m_sock->state() == QAbstractSocket::ConnectingState;
+}
+
+qint64 QRedisTcpTransport::write(const char *data, qint64 len)
+{
+	return m_sock->write(data, len);
+}
+
+bool QRedisTcpTransport::flush()
+{
+	return m_sock->flush();
+}
+
+QByteArray QRedisTcpTransport::readAll()
+{
+	return m_sock->readAll();
+}
+
+bool QRedisTcpTransport::waitForReadyRead(int msecs)
+{
+	return m_sock->waitForReadyRead(msecs);
+}
+
+QString QRedisTcpTransport::errorString() const
+{
+	return m_sock->errorString();
+}
+
+QRedisLocalTransport::QRedisLocalTransport(const QString &path, QObject *parent) : QRedisTransport(parent), m_path(path)
+{
+	m_sock = new QLocalSocket(this);
+	connect(m_sock, SIGNAL(readyRead()), this, SIGNAL(readyRead()));
+	connect(m_sock, SIGNAL(connected()), this, SIGNAL(connected()));
+	connect(m_sock, SIGNAL(disconnected()), this, SIGNAL(disconnected()));
+	connect(m_sock, SIGNAL(error(QLocalSocket::LocalSocketError)), this, SIGNAL(error()));
+}
+
+void QRedisLocalTransport::open()
+{
+	m_sock->connectToServer(m_path);
+}
+
+bool QRedisLocalTransport::waitForConnected(int msecs)
+{
+	return m_sock->waitForConnected(msecs);
+}
+
+void QRedisLocalTransport::close()
+{
+	m_sock->close();
+}
+
+bool QRedisLocalTransport::isConnected() const
+{
+	return m_sock->state() == QLocalSocket::ConnectedState;
+}
+
+bool QRedisLocalTransport::isConnecting() const
+{
+	return m_sock->state() == QLocalSocket::ConnectingState;
+}
+
+qint64 QRedisLocalTransport::write(const char *data, qint64 len)
+{
+	return m_sock->write(data, len);
+}
+
+bool QRedisLocalTransport::flush()
+{
+	return m_sock->flush();
+}
+
+QByteArray QRedisLocalTransport::readAll()
+{
+	return m_sock->readAll();
+}
+
+bool QRedisLocalTransport::waitForReadyRead(int msecs)
+{
+	return m_sock->waitForReadyRead(msecs);
+}
+
+QString QRedisLocalTransport::errorString() const
+{
+	return m_sock->errorString();
+}
+
+#ifdef Q_OS_LINUX
+
+QRedisEpollTransport::QRedisEpollTransport(const QString &host, quint16 port, QObject *parent)
+	: QRedisTransport(parent), m_fd(-1), m_epoll(-1), m_interest(0), m_notifier(0),
+	  m_state(EPOLL_UNCONNECTED), m_outpos(0), m_peerclosed(false), m_host(host), m_port(port)
+{
+
+}
+
+QRedisEpollTransport::~QRedisEpollTransport()
+{
+	release();
+}
+
+void QRedisEpollTransport::open()
+{
+	if (m_fd >= 0) return;
+
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	struct addrinfo *res = 0;
+	int rc = getaddrinfo(m_host.toUtf8().constData(), QByteArray::number(int(m_port)).constData(), &hints, &res);
+	if (rc != 0)
+	{
+		fail(gai_strerror(rc));
+		return;
+	}
+
+	m_fd = ::socket(res->ai_family, res->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, res->ai_protocol);
+	if (m_fd < 0)
+	{
+		freeaddrinfo(res);
+		fail(strerror(errno));
+		return;
+	}
+
+	int one = 1;
+	setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	rc = ::connect(m_fd, res->ai_addr, res->ai_addrlen);
+	freeaddrinfo(res);
+	if (rc < 0 && errno != EINPROGRESS)
+	{
+		fail(strerror(errno));
+		return;
+	}
+
+	m_epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (m_epoll < 0)
+	{
+		fail(strerror(errno));
+		return;
+	}
+
+	// writability signals the end of the connect, even when it completed at once
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLOUT;
+	ev.data.fd = m_fd;
+	epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_fd, &ev);
+	m_interest = EPOLLOUT;
+	m_state = EPOLL_CONNECTING;
+
+	m_notifier = new QSocketNotifier(m_epoll, QSocketNotifier::Read, this);
+	connect(m_notifier, SIGNAL(activated(int)), this, SLOT(activated()));
+}
+
+bool QRedisEpollTransport::waitForConnected(int msecs)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (m_state == EPOLL_CONNECTING)
+	{
+		int remaining = msecs < 0 ? -1 : msecs - int(timer.elapsed());
+		if (msecs >= 0 && remaining <= 0) return false;
+
+		quint32 events = poll(remaining);
+		if (!events) return false;
+		process(events);
+	}
+
+	return m_state == EPOLL_CONNECTED;
+}
+
+void QRedisEpollTransport::close()
+{
+	if (m_fd < 0) return;
+
+	bool wasconnected = m_state == EPOLL_CONNECTED;
+	release();
+	if (wasconnected) emit disconnected();
+}
+
+bool QRedisEpollTransport::isConnected() const
+{
+	return m_state == EPOLL_CONNECTED;
+}
+
+bool QRedisEpollTransport::isConnecting() const
+{
+	return m_state == EPOLL_CONNECTING;
+}
+
+qint64 QRedisEpollTransport::write(const char *data, qint64 len)
+{
+	if (m_state != EPOLL_CONNECTED) return -1;
+
+	// keep ordering behind anything still buffered
+	qint64 total = len;
+	if (m_out.isEmpty())
+	{
+		while (len > 0)
+		{
+			ssize_t n = ::send(m_fd, data, len, MSG_NOSIGNAL);
+			if (n < 0)
+			{
+				if (errno == EINTR) continue;
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+				{
+					m_error = strerror(errno);
+					return -1;
+				}
+				break;
+			}
+			data += n;
+			len -= n;
+		}
+		if (len == 0) return total;
+	}
+
+	m_out.append(QByteArray(data, int(len)));
+	update_interest();
+	return total;
+}
+
+qint64 QRedisEpollTransport::writev(const QList<QByteArray> &chunks)
+{
+	if (m_state != EPOLL_CONNECTED) return -1;
+
+	// queued behind anything still buffered, sent without copying
+	qint64 total = 0;
+	foreach (const QByteArray &chunk, chunks)
+	{
+		if (chunk.isEmpty()) continue;
+		m_out.append(chunk);
+		total += chunk.size();
+	}
+	if (send_queued() < 0) return -1;
+	return total;
+}
+
+bool QRedisEpollTransport::flush()
+{
+	return send_buffered();
+}
+
+QByteArray QRedisEpollTransport::readAll()
+{
+	QByteArray data;
+	if (m_fd < 0) return data;
+
+	int avail = 0;
+	if (ioctl(m_fd, FIONREAD, &avail) < 0 || avail <= 0) avail = 4096;
+
+	// straight into the buffer the parser takes over, no intermediate copy
+	data.resize(avail);
+	int size = 0;
+	forever
+	{
+		ssize_t n = ::recv(m_fd, data.data() + size, data.size() - size, 0);
+		if (n < 0 && errno == EINTR) continue;
+		if (n == 0) m_peerclosed = true;
+		if (n <= 0) break;
+
+		size += n;
+		if (size < data.size()) break;
+		data.resize(size * 2);
+	}
+
+	data.resize(size);
+	return data;
+}
+
+bool QRedisEpollTransport::waitForReadyRead(int msecs)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (m_fd >= 0)
+	{
+		int remaining = msecs < 0 ? -1 : msecs - int(timer.elapsed());
+		if (msecs >= 0 && remaining <= 0) return false;
+
+		quint32 events = poll(remaining);
+		if (!events) return false;
+		process(events);
+		if (events & EPOLLIN) return true;
+	}
+
+	return false;
+}
+
+QString QRedisEpollTransport::errorString() const
+{
+	return m_error;
+}
+
+void QRedisEpollTransport::activated()
+{
+	quint32 events = poll(0);
+	if (events) process(events);
+}
+
+quint32 QRedisEpollTransport::poll(int msecs)
+{
+	struct epoll_event ev;
+	int n;
+	do
+	{
+		n = epoll_wait(m_epoll, &ev, 1, msecs);
+	} while (n < 0 && errno == EINTR);
+
+	return n > 0 ? ev.events : 0;
+}
+
+void QRedisEpollTransport::process(quint32 events)
+{
+	if (m_state == EPOLL_CONNECTING)
+	{
+		int err = 0;
+		socklen_t len = sizeof(err);
+		getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &err, &len);
+		if (err != 0)
+		{
+			fail(strerror(err));
+			return;
+		}
+
+		m_state = EPOLL_CONNECTED;
+		update_interest();
+		emit connected();
+		return;
+	}
+
+	if (events & EPOLLOUT) send_buffered();
+
+	// the receiver may close us from inside readyRead
+	if (m_fd >= 0 && (events & EPOLLIN)) emit readyRead();
+	if (m_fd >= 0 && (m_peerclosed || (events & (EPOLLERR | EPOLLHUP))))
+	{
+		if (m_error.isEmpty()) m_error = "remote host closed the connection";
+		close();
+	}
+}
+
+bool QRedisEpollTransport::send_buffered()
+{
+	if (m_fd < 0) return false;
+	return send_queued() > 0;
+}
+
+qint64 QRedisEpollTransport::send_queued()
+{
+	qint64 total = 0;
+	while (!m_out.isEmpty())
+	{
+		struct iovec iov[64];
+		int count = qMin(m_out.count(), 64);
+		for (int i = 0; i < count; i++)
+		{
+			int skip = i == 0 ? m_outpos : 0;
+			iov[i].iov_base = const_cast<char *>(m_out.at(i).constData()) + skip;
+			iov[i].iov_len = m_out.at(i).size() - skip;
+		}
+
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = count;
+		ssize_t n = ::sendmsg(m_fd, &msg, MSG_NOSIGNAL);
+		if (n < 0)
+		{
+			if (errno == EINTR) continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				m_error = strerror(errno);
+				return -1;
+			}
+			break;
+		}
+		total += n;
+
+		// drop what the kernel took
+		while (n > 0)
+		{
+			qint64 left = m_out.first().size() - m_outpos;
+			if (n < left)
+			{
+				m_outpos += n;
+				break;
+			}
+			n -= left;
+			m_out.removeFirst();
+			m_outpos = 0;
+		}
+	}
+
+	update_interest();
+	return total;
+}
+
+void QRedisEpollTransport::update_interest()
+{
+	quint32 interest = EPOLLIN;
+	if (!m_out.isEmpty()) interest |= EPOLLOUT;
+	if (interest == m_interest) return;
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = interest;
+	ev.data.fd = m_fd;
+	epoll_ctl(m_epoll, EPOLL_CTL_MOD, m_fd, &ev);
+	m_interest = interest;
+}
+
+void QRedisEpollTransport::fail(const QString &error)
+{
+	release();
+	m_error = error;
+	emit this->error();
+}
+
+void QRedisEpollTransport::release()
+{
+	if (m_notifier)
+	{
+		// may be called from inside the notifier's own activated()
+		m_notifier->setEnabled(false);
+		m_notifier->deleteLater();
+		m_notifier = 0;
+	}
+	if (m_epoll >= 0) ::close(m_epoll);
+	if (m_fd >= 0) ::close(m_fd);
+
+	m_fd = -1;
+	m_epoll = -1;
+	m_interest = 0;
+	m_state = EPOLL_UNCONNECTED;
+	m_out.clear();
+	m_outpos = 0;
+	m_peerclosed = false;
+}
+
+#else
+
+QRedisEpollTransport::QRedisEpollTransport(const QString &host, quint16 port, QObject *parent)
+	: QRedisTransport(parent), m_fd(-1), m_epoll(-1), m_interest(0), m_notifier(0),
+	  m_state(EPOLL_UNCONNECTED), m_outpos(0), m_peerclosed(false), m_host(host), m_port(port)
+{
+
+}
+
+QRedisEpollTransport::~QRedisEpollTransport()
+{
+}
+
+void QRedisEpollTransport::open()
+{
+	fail("epoll is only available on Linux");
+}
+
+bool QRedisEpollTransport::waitForConnected(int)
+{
+	return false;
+}
+
+void QRedisEpollTransport::close()
+{
+}
+
+bool QRedisEpollTransport::isConnected() const
+{
+	return false;
+}
+
+bool QRedisEpollTransport::isConnecting() const
+{
+	return false;
+}
+
+qint64 QRedisEpollTransport::write(const char *, qint64)
+{
+	return -1;
+}
+
+qint64 QRedisEpollTransport::writev(const QList<QByteArray> &)
+{
+	return -1;
+}
+
+bool QRedisEpollTransport::flush()
+{
+	return false;
+}
+
+QByteArray QRedisEpollTransport::readAll()
+{
+	return QByteArray();
+}
+
+bool QRedisEpollTransport::waitForReadyRead(int)
+{
+	return false;
+}
+
+QString QRedisEpollTransport::errorString() const
+{
+	return m_error;
+}
+
+void QRedisEpollTransport::activated()
+{
+}
+
+quint32 QRedisEpollTransport::poll(int)
+{
+	return 0;
+}
+
+void QRedisEpollTransport::process(quint32)
+{
+}
+
+bool QRedisEpollTransport::send_buffered()
+{
+	return false;
+}
+
+qint64 QRedisEpollTransport::send_queued()
+{
+	return -1;
+}
+
+void QRedisEpollTransport::update_interest()
+{
+}
+
+void QRedisEpollTransport::fail(const QString &error)
+{
+	m_error = error;
+	emit this->error();
+}
+
+void QRedisEpollTransport::release()
+{
+}
+
+#endif
+
+#ifdef QREDIS_HAVE_LIBURING
+
+enum redis_uring_kind
+{
+	URING_OP_CONNECT,
+	URING_OP_RECV,
+	URING_OP_SEND
+};
+
+/*
+ * One in-flight request. It owns the memory the kernel reads or writes, so
+ * a transport closed before the completion arrives only detaches itself.
+ * A send references the queued chunks, the first one from offset on.
+ * result is kept for a completion collected while changing threads.
+ */
+struct redis_uring_op
+{
+	redis_uring_op() : transport(0), kind(URING_OP_CONNECT), offset(0), result(0) {}
+	QRedisUringTransport *transport;
+	redis_uring_kind kind;
+	QByteArray buffer;
+	QList<QByteArray> chunks;
+	int offset;
+	struct iovec iov[64];
+	struct msghdr msg;
+	int result;
+};
+
+/*
+ * io_uring instance shared by the uring transports of one thread.
+ */
+class redis_uring : public QObject
+{
+	Q_OBJECT
+public:
+	static redis_uring *acquire();
+	void release();
+	struct io_uring_sqe *sqe(redis_uring_op *op);
+	void submitSoon();
+	bool wait(int msecs);
+public slots:
+	void submit();
+private slots:
+	void activated();
+private:
+	redis_uring();
+	~redis_uring();
+	void dispatch();
+private:
+	struct io_uring m_ring;
+	bool m_ok;
+	int m_eventfd;
+	QSocketNotifier *m_notifier;
+	int m_refs;
+	int m_inflight;
+	bool m_submitscheduled;
+	static thread_local redis_uring *s_instance;
+};
+
+thread_local redis_uring *redis_uring::s_instance = 0;
+
+redis_uring::redis_uring() : m_ok(false), m_eventfd(-1), m_notifier(0), m_refs(0), m_inflight(0), m_submitscheduled(false)
+{
+	if (io_uring_queue_init(256, &m_ring, 0) < 0) return;
+
+	m_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_eventfd < 0 || io_uring_register_eventfd(&m_ring, m_eventfd) < 0)
+	{
+		if (m_eventfd >= 0) ::close(m_eventfd);
+		m_eventfd = -1;
+		io_uring_queue_exit(&m_ring);
+		return;
+	}
+
+	m_notifier = new QSocketNotifier(m_eventfd, QSocketNotifier::Read, this);
+	connect(m_notifier, SIGNAL(activated(int)), this, SLOT(activated()));
+	m_ok = true;
+}
+
+redis_uring::~redis_uring()
+{
+	if (!m_ok) return;
+
+	delete m_notifier;
+	io_uring_queue_exit(&m_ring);
+	::close(m_eventfd);
+}
+
+redis_uring *redis_uring::acquire()
+{
+	if (!s_instance)
+	{
+		redis_uring *ring = new redis_uring;
+		if (!ring->m_ok)
+		{
+			delete ring;
+			return 0;
+		}
+		s_instance = ring;
+	}
+
+	s_instance->m_refs++;
+	return s_instance;
+}
+
+void redis_uring::release()
+{
+	if (--m_refs > 0) return;
+
+	// requests still in flight own their buffers; dispatch() finishes the job once they drain
+	submit();
+	if (m_inflight == 0)
+	{
+		s_instance = 0;
+		deleteLater();
+	}
+}
+
+struct io_uring_sqe *redis_uring::sqe(redis_uring_op *op)
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+	if (!sqe)
+	{
+		io_uring_submit(&m_ring);
+		sqe = io_uring_get_sqe(&m_ring);
+	}
+
+	if (op) m_inflight++;
+	return sqe;
+}
+
+void redis_uring::submitSoon()
+{
+	// every request queued before we get back to the event loop shares one submission
+	if (m_submitscheduled) return;
+	m_submitscheduled = true;
+	QTimer::singleShot(0, this, SLOT(submit()));
+}
+
+void redis_uring::submit()
+{
+	m_submitscheduled = false;
+	io_uring_submit(&m_ring);
+}
+
+bool redis_uring::wait(int msecs)
+{
+	submit();
+
+	struct io_uring_cqe *cqe = 0;
+	int rc;
+	if (msecs < 0)
+	{
+		rc = io_uring_wait_cqe(&m_ring, &cqe);
+	}
+	else
+	{
+		struct __kernel_timespec ts;
+		ts.tv_sec = msecs / 1000;
+		ts.tv_nsec = (msecs % 1000) * 1000000LL;
+		rc = io_uring_wait_cqe_timeout(&m_ring, &cqe, &ts);
+	}
+	if (rc < 0) return false;
+
+	dispatch();
+	return true;
+}
+
+void redis_uring::activated()
+{
+	quint64 value;
+	if (::read(m_eventfd, &value, sizeof(value)) < 0)
+	{
+		// nothing signalled; completions are reaped below regardless
+	}
+	dispatch();
+}
+
+void redis_uring::dispatch()
+{
+	struct io_uring_cqe *cqe;
+	while (io_uring_peek_cqe(&m_ring, &cqe) == 0)
+	{
+		redis_uring_op *op = static_cast<redis_uring_op *>(io_uring_cqe_get_data(cqe));
+		int result = cqe->res;
+
+		// marked seen first: completing may re-enter through a blocking wait
+		io_uring_cqe_seen(&m_ring, cqe);
+		if (!op) continue;
+
+		m_inflight--;
+		if (op->transport) op->transport->complete(op, result);
+		delete op;
+	}
+
+	if (m_refs == 0 && m_inflight == 0 && s_instance == this)
+	{
+		s_instance = 0;
+		deleteLater();
+	}
+}
+
+QRedisUringTransport::QRedisUringTransport(const QString &host, quint16 port, QObject *parent)
+	: QRedisTransport(parent), m_ring(0), m_fd(-1), m_state(URING_UNCONNECTED),
+	  m_connectop(0), m_recvop(0), m_sendop(0), m_detaching(false), m_recvsize(16384), m_received(0),
+	  m_outpos(0), m_outappend(false), m_host(host), m_port(port)
+{
+
+}
+
+QRedisUringTransport::~QRedisUringTransport()
+{
+	release();
+}
+
+bool QRedisUringTransport::isAvailable()
+{
+	static int available = -1;
+	if (available < 0)
+	{
+		struct io_uring ring;
+		available = io_uring_queue_init(2, &ring, 0) == 0;
+		if (available) io_uring_queue_exit(&ring);
+	}
+	return available;
+}
+
+void QRedisUringTransport::open()
+{
+	if (m_fd >= 0) return;
+
+	m_ring = redis_uring::acquire();
+	if (!m_ring)
+	{
+		fail("io_uring is not available");
+		return;
+	}
+
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	struct addrinfo *res = 0;
+	int rc = getaddrinfo(m_host.toUtf8().constData(), QByteArray::number(int(m_port)).constData(), &hints, &res);
+	if (rc != 0)
+	{
+		fail(gai_strerror(rc));
+		return;
+	}
+
+	m_fd = ::socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, res->ai_protocol);
+	if (m_fd < 0)
+	{
+		freeaddrinfo(res);
+		fail(strerror(errno));
+		return;
+	}
+
+	int one = 1;
+	setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	QByteArray address(reinterpret_cast<const char *>(res->ai_addr), res->ai_addrlen);
+	freeaddrinfo(res);
+	post_connect(address);
+	m_state = URING_CONNECTING;
+}
+
+bool QRedisUringTransport::waitForConnected(int msecs)
+{
+	attach();
+	QElapsedTimer timer;
+	timer.start();
+	while (m_state == URING_CONNECTING)
+	{
+		int remaining = msecs < 0 ? -1 : msecs - int(timer.elapsed());
+		if (msecs >= 0 && remaining <= 0) return false;
+		if (!m_ring->wait(remaining)) return false;
+	}
+
+	return m_state == URING_CONNECTED;
+}
+
+void QRedisUringTransport::close()
+{
+	if (m_fd < 0) return;
+
+	bool wasconnected = m_state == URING_CONNECTED;
+	release();
+	if (wasconnected) emit disconnected();
+}
+
+bool QRedisUringTransport::isConnected() const
+{
+	return m_state == URING_CONNECTED;
+}
+
+bool QRedisUringTransport::isConnecting() const
+{
+	return m_state == URING_CONNECTING;
+}
+
+qint64 QRedisUringTransport::write(const char *data, qint64 len)
+{
+	attach();
+	if (m_state != URING_CONNECTED) return -1;
+
+	// collected until the send in flight completes, then sent as one request
+	if (m_outappend && !m_out.isEmpty())
+	{
+		m_out.last().append(data, int(len));
+	}
+	else
+	{
+		m_out.append(QByteArray(data, int(len)));
+		m_outappend = true;
+	}
+	if (!m_sendop) post_send();
+	return len;
+}
+
+qint64 QRedisUringTransport::writev(const QList<QByteArray> &chunks)
+{
+	attach();
+	if (m_state != URING_CONNECTED) return -1;
+
+	// queued behind anything still buffered, sent without copying
+	qint64 total = 0;
+	foreach (const QByteArray &chunk, chunks)
+	{
+		if (chunk.isEmpty()) continue;
+		m_out.append(chunk);
+		total += chunk.size();
+	}
+	m_outappend = false;
+	if (!m_sendop && !m_out.isEmpty()) post_send();
+	return total;
+}
+
+bool QRedisUringTransport::flush()
+{
+	attach();
+	if (!m_ring) return false;
+	m_ring->submitSoon();
+	return true;
+}
+
+QByteArray QRedisUringTransport::readAll()
+{
+	QByteArray data = m_in;
+	m_in.clear();
+	return data;
+}
+
+bool QRedisUringTransport::waitForReadyRead(int msecs)
+{
+	attach();
+	if (!m_in.isEmpty()) return true;
+	if (!m_ring) return false;
+
+	// a readyRead receiver may drain m_in before we get to look at it
+	quint64 received = m_received;
+	QElapsedTimer timer;
+	timer.start();
+	while (m_received == received)
+	{
+		if (m_state != URING_CONNECTED) return false;
+
+		int remaining = msecs < 0 ? -1 : msecs - int(timer.elapsed());
+		if (msecs >= 0 && remaining <= 0) return false;
+		if (!m_ring->wait(remaining)) return false;
+	}
+
+	return true;
+}
+
+QString QRedisUringTransport::errorString() const
+{
+	return m_error;
+}
+
+void QRedisUringTransport::complete(redis_uring_op *op, int result)
+{
+	if (op == m_connectop) m_connectop = 0;
+	if (op == m_recvop) m_recvop = 0;
+	if (op == m_sendop) m_sendop = 0;
+
+	if (m_detaching)
+	{
+		// finished by attach() on the thread being moved to
+		redis_uring_op *settled = new redis_uring_op(*op);
+		settled->result = result;
+		m_settled.append(settled);
+		return;
+	}
+
+	if (result < 0)
+	{
+		if (result == -ECANCELED) return;
+		fail(strerror(-result));
+		return;
+	}
+
+	if (op->kind == URING_OP_CONNECT)
+	{
+		m_state = URING_CONNECTED;
+		post_recv();
+		if (!m_out.isEmpty()) post_send();
+		emit connected();
+	}
+	else if (op->kind == URING_OP_RECV)
+	{
+		if (result == 0)
+		{
+			m_error = "remote host closed the connection";
+			close();
+			return;
+		}
+
+		// the filled buffer is handed over as is; a full one means we should read more at once
+		op->buffer.resize(result);
+		if (m_in.isEmpty())
+		{
+			m_in = op->buffer;
+		}
+		else
+		{
+			m_in.append(op->buffer);
+		}
+		if (result == m_recvsize && m_recvsize < 1024 * 1024) m_recvsize *= 2;
+		m_received++;
+
+		post_recv();
+		emit readyRead();
+	}
+	else if (op->kind == URING_OP_SEND)
+	{
+		requeue(op, result);
+		if (!m_out.isEmpty()) post_send();
+	}
+}
+
+bool QRedisUringTransport::event(QEvent *e)
+{
+	if (e->type() == QEvent::ThreadChange)
+	{
+		// sent on the thread being left, which owns the ring; a thread
+		// without an event loop attaches on first use instead
+		detach();
+		QMetaObject::invokeMethod(this, "attach", Qt::QueuedConnection);
+	}
+	return QRedisTransport::event(e);
+}
+
+void QRedisUringTransport::detach()
+{
+	if (!m_ring) return;
+
+	// cancelled and waited for here, so that no completion is dispatched
+	// by the old thread once the new one uses the socket
+	m_detaching = true;
+	redis_uring_op *ops[] = { m_connectop, m_recvop, m_sendop };
+	for (int i = 0; i < 3; i++)
+	{
+		if (!ops[i]) continue;
+
+		struct io_uring_sqe *sqe = m_ring->sqe(0);
+		io_uring_prep_cancel(sqe, ops[i], 0);
+		io_uring_sqe_set_data(sqe, 0);
+	}
+	while (m_connectop || m_recvop || m_sendop)
+	{
+		m_ring->wait(-1);
+	}
+	m_detaching = false;
+
+	m_ring->release();
+	m_ring = 0;
+}
+
+void QRedisUringTransport::attach()
+{
+	if (m_ring || m_fd < 0) return;
+
+	m_ring = redis_uring::acquire();
+	if (!m_ring)
+	{
+		release();
+		fail("io_uring is not available");
+		return;
+	}
+
+	// what detach() collected, in the order it completed; a cancelled
+	// request is sent again
+	QList<redis_uring_op *> settled = m_settled;
+	m_settled.clear();
+	foreach (redis_uring_op *op, settled)
+	{
+		if (m_fd >= 0 && op->result != -ECANCELED)
+		{
+			complete(op, op->result);
+		}
+		else if (m_fd >= 0 && op->kind == URING_OP_CONNECT)
+		{
+			post_connect(op->buffer);
+		}
+		else if (op->kind == URING_OP_SEND)
+		{
+			requeue(op, 0);
+		}
+		delete op;
+	}
+
+	if (m_state != URING_CONNECTED) return;
+	if (!m_recvop) post_recv();
+	if (!m_sendop && !m_out.isEmpty()) post_send();
+}
+
+void QRedisUringTransport::post_connect(const QByteArray &address)
+{
+	m_connectop = new redis_uring_op;
+	m_connectop->transport = this;
+	m_connectop->kind = URING_OP_CONNECT;
+	m_connectop->buffer = address;
+
+	struct io_uring_sqe *sqe = m_ring->sqe(m_connectop);
+	io_uring_prep_connect(sqe, m_fd, reinterpret_cast<struct sockaddr *>(m_connectop->buffer.data()), m_connectop->buffer.size());
+	io_uring_sqe_set_data(sqe, m_connectop);
+	m_ring->submitSoon();
+}
+
+void QRedisUringTransport::post_recv()
+{
+	m_recvop = new redis_uring_op;
+	m_recvop->transport = this;
+	m_recvop->kind = URING_OP_RECV;
+	m_recvop->buffer.resize(m_recvsize);
+
+	struct io_uring_sqe *sqe = m_ring->sqe(m_recvop);
+	io_uring_prep_recv(sqe, m_fd, m_recvop->buffer.data(), m_recvop->buffer.size(), 0);
+	io_uring_sqe_set_data(sqe, m_recvop);
+	m_ring->submitSoon();
+}
+
+void QRedisUringTransport::post_send()
+{
+	m_sendop = new redis_uring_op;
+	m_sendop->transport = this;
+	m_sendop->kind = URING_OP_SEND;
+	m_sendop->offset = m_outpos;
+	m_outpos = 0;
+
+	// the op keeps its own references to the chunks the iovec points into
+	int count = qMin(m_out.count(), 64);
+	for (int i = 0; i < count; i++)
+	{
+		m_sendop->chunks.append(m_out.takeFirst());
+		int skip = i == 0 ? m_sendop->offset : 0;
+		m_sendop->iov[i].iov_base = const_cast<char *>(m_sendop->chunks.at(i).constData()) + skip;
+		m_sendop->iov[i].iov_len = m_sendop->chunks.at(i).size() - skip;
+	}
+	memset(&m_sendop->msg, 0, sizeof(m_sendop->msg));
+	m_sendop->msg.msg_iov = m_sendop->iov;
+	m_sendop->msg.msg_iovlen = count;
+
+	struct io_uring_sqe *sqe = m_ring->sqe(m_sendop);
+	io_uring_prep_sendmsg(sqe, m_fd, &m_sendop->msg, MSG_NOSIGNAL);
+	io_uring_sqe_set_data(sqe, m_sendop);
+	m_ring->submitSoon();
+}
+
+void QRedisUringTransport::requeue(redis_uring_op *op, qint64 sent)
+{
+	// skip what the kernel took, put the rest back ahead of anything queued since
+	int i = 0;
+	qint64 pos = op->offset + sent;
+	while (i < op->chunks.count() && pos >= op->chunks.at(i).size())
+	{
+		pos -= op->chunks.at(i).size();
+		i++;
+	}
+	if (i == op->chunks.count()) return;
+
+	if (m_out.isEmpty()) m_outappend = false;
+	for (int j = op->chunks.count() - 1; j >= i; j--)
+	{
+		m_out.prepend(op->chunks.at(j));
+	}
+	m_outpos = int(pos);
+}
+
+void QRedisUringTransport::fail(const QString &error)
+{
+	bool wasconnected = m_state == URING_CONNECTED;
+	release();
+	m_error = error;
+	emit this->error();
+	if (wasconnected) emit disconnected();
+}
+
+void QRedisUringTransport::release()
+{
+	redis_uring_op *ops[] = { m_connectop, m_recvop, m_sendop };
+	for (int i = 0; i < 3; i++)
+	{
+		if (!ops[i]) continue;
+
+		// the op is freed when its (cancelled) completion arrives
+		ops[i]->transport = 0;
+		struct io_uring_sqe *sqe = m_ring->sqe(0);
+		io_uring_prep_cancel(sqe, ops[i], 0);
+		io_uring_sqe_set_data(sqe, 0);
+	}
+	m_connectop = 0;
+	m_recvop = 0;
+	m_sendop = 0;
+	qDeleteAll(m_settled);
+	m_settled.clear();
+
+	// submitted now: while a recv is pending it holds the socket open, and
+	// other transports may keep the ring alive long after this one is gone
+	if (m_ring) m_ring->submit();
+	if (m_fd >= 0) ::close(m_fd);
+	if (m_ring) m_ring->release();
+
+	m_fd = -1;
+	m_ring = 0;
+	m_state = URING_UNCONNECTED;
+	m_in.clear();
+	m_out.clear();
+	m_outpos = 0;
+	m_outappend = false;
+}
+
+#include "qredistransport.moc"
+
+#else
+
+QRedisUringTransport::QRedisUringTransport(const QString &host, quint16 port, QObject *parent)
+	: QRedisTransport(parent), m_ring(0), m_fd(-1), m_state(URING_UNCONNECTED),
+	  m_connectop(0), m_recvop(0), m_sendop(0), m_detaching(false), m_recvsize(16384), m_received(0),
+	  m_outpos(0), m_outappend(false), m_host(host), m_port(port)
+{
+
+}
+
+QRedisUringTransport::~QRedisUringTransport()
+{
+}
+
+bool QRedisUringTransport::isAvailable()
+{
+	return false;
+}
+
+void QRedisUringTransport::open()
+{
+	fail("built without io_uring support");
+}
+
+bool QRedisUringTransport::waitForConnected(int)
+{
+	return false;
+}
+
+void QRedisUringTransport::close()
+{
+}
+
+bool QRedisUringTransport::isConnected() const
+{
+	return false;
+}
+
+bool QRedisUringTransport::isConnecting() const
+{
+	return false;
+}
+
+qint64 QRedisUringTransport::write(const char *, qint64)
+{
+	return -1;
+}
+
+qint64 QRedisUringTransport::writev(const QList<QByteArray> &)
+{
+	return -1;
+}
+
+bool QRedisUringTransport::flush()
+{
+	return false;
+}
+
+QByteArray QRedisUringTransport::readAll()
+{
+	return QByteArray();
+}
+
+bool QRedisUringTransport::waitForReadyRead(int)
+{
+	return false;
+}
+
+QString QRedisUringTransport::errorString() const
+{
+	return m_error;
+}
+
+void QRedisUringTransport::complete(redis_uring_op *, int)
+{
+}
+
+bool QRedisUringTransport::event(QEvent *e)
+{
+	return QRedisTransport::event(e);
+}
+
+void QRedisUringTransport::detach()
+{
+}
+
+void QRedisUringTransport::attach()
+{
+}
+
+void QRedisUringTransport::post_connect(const QByteArray &)
+{
+}
+
+void QRedisUringTransport::post_recv()
+{
+}
+
+void QRedisUringTransport::post_send()
+{
+}
+
+void QRedisUringTransport::requeue(redis_uring_op *, qint64)
+{
+}
+
+void QRedisUringTransport::fail(const QString &error)
+{
+	m_error = error;
+	emit this->error();
+}
+
+void QRedisUringTransport::release()
+{
+}
+
+#endif
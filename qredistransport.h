@@ -0,0 +1,214 @@
+#ifndef _QREDISTRANSPORT_H_
+#define _QREDISTRANSPORT_H_
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+
+class QTcpSocket;
+class QLocalSocket;
+class QSocketNotifier;
+class QEvent;
+class redis_uring;
+struct redis_uring_op;
+
+/*
+ * Byte stream to a redis server. QRedis only talks to its command and
+ * subscriber connections through this interface, so the kind of socket is
+ * picked when connecting.
+ */
+class QRedisTransport : public QObject
+{
+	Q_OBJECT
+public:
+	QRedisTransport(QObject *parent = 0);
+	virtual ~QRedisTransport();
+public:
+	virtual void open() = 0;
+	virtual bool waitForConnected(int msecs) = 0;
+	virtual void close() = 0;
+	virtual bool isConnected() const = 0;
+	virtual bool isConnecting() const = 0;
+	virtual qint64 write(const char *data, qint64 len) = 0;
+	virtual qint64 writev(const QList<QByteArray> &chunks);
+	virtual bool flush() = 0;
+	virtual QByteArray readAll() = 0;
+	virtual bool waitForReadyRead(int msecs) = 0;
+	virtual QString errorString() const = 0;
+signals:
+	void connected();
+	void disconnected();
+	void readyRead();
+	void error();
+};
+
+class QRedisTcpTransport : public QRedisTransport
+{
+	Q_OBJECT
+public:
+	QRedisTcpTransport(const QString &host, quint16 port, QObject *parent = 0);
+public:
+	void open();
+	bool waitForConnected(int msecs);
+	void close();
+	bool isConnected() const;
+	bool isConnecting() const;
+	qint64 write(const char *data, qint64 len);
+	bool flush();
+	QByteArray readAll();
+	bool waitForReadyRead(int msecs);
+	QString errorString() const;
+private:
+	QTcpSocket *m_sock;
+	QString m_host;
+	quint16 m_port;
+};
+
+class QRedisLocalTransport : public QRedisTransport
+{
+	Q_OBJECT
+public:
+	QRedisLocalTransport(const QString &path, QObject *parent = 0);
+public:
+	void open();
+	bool waitForConnected(int msecs);
+	void close();
+	bool isConnected() const;
+	bool isConnecting() const;
+	qint64 write(const char *data, qint64 len);
+	bool flush();
+	QByteArray readAll();
+	bool waitForReadyRead(int msecs);
+	QString errorString() const;
+private:
+	QLocalSocket *m_sock;
+	QString m_path;
+};
+
+/*
+ * TCP transport driving a non-blocking socket directly through epoll, for
+ * Linux only. Received bytes go straight from the kernel into the buffer
+ * handed to the parser; writes the kernel does not take at once are kept
+ * in an outgoing queue drained on EPOLLOUT. Gathered writes go out with
+ * sendmsg() and keep references to their chunks instead of copying them.
+ * The epoll descriptor is watched by a QSocketNotifier, so it runs in the
+ * Qt event loop.
+ */
+class QRedisEpollTransport : public QRedisTransport
+{
+	Q_OBJECT
+public:
+	QRedisEpollTransport(const QString &host, quint16 port, QObject *parent = 0);
+	~QRedisEpollTransport();
+public:
+	void open();
+	bool waitForConnected(int msecs);
+	void close();
+	bool isConnected() const;
+	bool isConnecting() const;
+	qint64 write(const char *data, qint64 len);
+	qint64 writev(const QList<QByteArray> &chunks);
+	bool flush();
+	QByteArray readAll();
+	bool waitForReadyRead(int msecs);
+	QString errorString() const;
+private slots:
+	void activated();
+private:
+	enum state_t
+	{
+		EPOLL_UNCONNECTED,
+		EPOLL_CONNECTING,
+		EPOLL_CONNECTED
+	};
+	quint32 poll(int msecs);
+	void process(quint32 events);
+	bool send_buffered();
+	qint64 send_queued();
+	void update_interest();
+	void fail(const QString &error);
+	void release();
+private:
+	int m_fd;
+	int m_epoll;
+	quint32 m_interest;
+	QSocketNotifier *m_notifier;
+	state_t m_state;
+	QList<QByteArray> m_out;
+	int m_outpos;
+	bool m_peerclosed;
+	QString m_error;
+	QString m_host;
+	quint16 m_port;
+};
+
+/*
+ * TCP transport on io_uring, available when built with
+ * QREDIS_HAVE_LIBURING and running on a kernel that supports it. All such
+ * transports of a thread share one ring, so the sends and receives every
+ * connection queued during an event-loop iteration reach the kernel in a
+ * single submission. Sends go out with IORING_OP_SENDMSG, so gathered
+ * writes reach the kernel without copying their chunks. Completions are
+ * signalled to the event loop through an eventfd. Moved to another thread, a transport finishes what it has
+ * in flight on the old thread's ring and continues on the new thread's.
+ */
+class QRedisUringTransport : public QRedisTransport
+{
+	Q_OBJECT
+public:
+	QRedisUringTransport(const QString &host, quint16 port, QObject *parent = 0);
+	~QRedisUringTransport();
+	static bool isAvailable();
+public:
+	void open();
+	bool waitForConnected(int msecs);
+	void close();
+	bool isConnected() const;
+	bool isConnecting() const;
+	qint64 write(const char *data, qint64 len);
+	qint64 writev(const QList<QByteArray> &chunks);
+	bool flush();
+	QByteArray readAll();
+	bool waitForReadyRead(int msecs);
+	QString errorString() const;
+	bool event(QEvent *e);
+private slots:
+	void attach();
+private:
+	friend class redis_uring;
+	enum state_t
+	{
+		URING_UNCONNECTED,
+		URING_CONNECTING,
+		URING_CONNECTED
+	};
+	void complete(redis_uring_op *op, int result);
+	void detach();
+	void post_connect(const QByteArray &address);
+	void post_recv();
+	void post_send();
+	void requeue(redis_uring_op *op, qint64 sent);
+	void fail(const QString &error);
+	void release();
+private:
+	redis_uring *m_ring;
+	int m_fd;
+	state_t m_state;
+	redis_uring_op *m_connectop;
+	redis_uring_op *m_recvop;
+	redis_uring_op *m_sendop;
+	bool m_detaching;
+	QList<redis_uring_op *> m_settled;
+	int m_recvsize;
+	quint64 m_received;
+	QByteArray m_in;
+	QList<QByteArray> m_out;
+	int m_outpos;
+	bool m_outappend;
+	QString m_error;
+	QString m_host;
+	quint16 m_port;
+};
+
+#endif //_QREDISTRANSPORT_H_
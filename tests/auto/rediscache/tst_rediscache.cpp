@@ -0,0 +1,173 @@
+#include <QtTest>
+#include "qredis.h"
+#include "redistest.h"
+
+/*
+ * Client side caching against the server named by REDIS_TEST_HOST: a
+ * write, from another connection or from the caching one itself, must
+ * reach the cache before the stale value is served again, under both ways
+ * the server delivers invalidations.
+ */
+
+static const char KEY[] = "qredis:test:cache";
+static const char CHANNEL[] = "qredis:test:cache:channel";
+
+// a get answered from the cache with the expected value
+static bool cached(QRedis &redis, const QString &key, const QString &value)
+{
+	qlonglong hits = redis.cacheHits();
+	return redis.get(key) == value && redis.cacheHits() == hits + 1;
+}
+
+class tst_rediscache : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanup();
+	void invalidation_data();
+	void invalidation();
+	void ownWrite_data();
+	void ownWrite();
+	void prefixes();
+	void messagesDuringLookup();
+private:
+	bool open(QRedis &redis);
+	QString m_host;
+	quint16 m_port;
+};
+
+void tst_rediscache::initTestCase()
+{
+	if (!redis_test_host(m_host, m_port)) QSKIP("set REDIS_TEST_HOST=host[:port] to run");
+}
+
+void tst_rediscache::cleanup()
+{
+	QRedis redis;
+	if (open(redis)) redis.del(KEY);
+}
+
+bool tst_rediscache::open(QRedis &redis)
+{
+	redis.connectHost(m_host, m_port);
+	return redis.isConnected();
+}
+
+void tst_rediscache::invalidation_data()
+{
+	QTest::addColumn<int>("protocol");
+	QTest::addColumn<QStringList>("prefixes");
+
+	QTest::newRow("resp2 redirect") << 2 << QStringList();
+	QTest::newRow("resp2 bcast") << 2 << (QStringList() << "qredis:test:");
+	QTest::newRow("resp3 push") << 3 << QStringList();
+	QTest::newRow("resp3 bcast") << 3 << (QStringList() << "qredis:test:");
+}
+
+void tst_rediscache::invalidation()
+{
+	QFETCH(int, protocol);
+	QFETCH(QStringList, prefixes);
+
+	QRedis reader, writer;
+	QVERIFY(open(reader));
+	QVERIFY(open(writer));
+	if (protocol == 3) QVERIFY(reader.hello(3));
+
+	QVERIFY(writer.set(KEY, "one"));
+	reader.enableCache(1 << 20, prefixes);
+
+	// tracking is on once the first miss has been stored
+	QTRY_VERIFY(cached(reader, KEY, "one"));
+	QVERIFY(cached(reader, KEY, "one"));
+
+	// the server sends the invalidation ahead of the writer's reply, so the
+	// first read after it must not be stale
+	QVERIFY(writer.set(KEY, "two"));
+	QCOMPARE(reader.get(KEY), QString("two"));
+	QTRY_VERIFY(cached(reader, KEY, "two"));
+
+	QCOMPARE(writer.del(KEY), 1);
+	QCOMPARE(reader.get(KEY), QString());
+}
+
+void tst_rediscache::ownWrite_data()
+{
+	QTest::addColumn<int>("protocol");
+
+	QTest::newRow("resp2 redirect") << 2;
+	QTest::newRow("resp3 push") << 3;
+}
+
+void tst_rediscache::ownWrite()
+{
+	QFETCH(int, protocol);
+
+	QRedis redis;
+	QVERIFY(open(redis));
+	if (protocol == 3) QVERIFY(redis.hello(3));
+
+	QVERIFY(redis.set(KEY, "one"));
+	redis.enableCache(1 << 20);
+	QTRY_VERIFY(cached(redis, KEY, "one"));
+
+	// under RESP2 the invalidation may still be on its way
+	QVERIFY(redis.set(KEY, "two"));
+	QCOMPARE(redis.get(KEY), QString("two"));
+	QTRY_VERIFY(cached(redis, KEY, "two"));
+
+	QCOMPARE(redis.del(KEY), 1);
+	QCOMPARE(redis.get(KEY), QString());
+}
+
+void tst_rediscache::prefixes()
+{
+	QRedis redis;
+	QVERIFY(open(redis));
+	QVERIFY(redis.set(KEY, "one"));
+	redis.enableCache(1 << 20, QStringList() << "qredis:test:other:");
+
+	qlonglong misses = redis.cacheMisses();
+	QCOMPARE(redis.get(KEY), QString("one"));
+	QCOMPARE(redis.get(KEY), QString("one"));
+	QCOMPARE(redis.cacheHits(), qlonglong(0));
+	QCOMPARE(redis.cacheMisses(), misses);
+}
+
+void tst_rediscache::messagesDuringLookup()
+{
+	QRedis reader, writer;
+	QVERIFY(open(reader));
+	QVERIFY(open(writer));
+
+	bool lookup = false;
+	int received = 0;
+	int receivedInLookup = 0;
+	connect(&reader, &QRedis::subscribeRaw, [&](const QByteArray &, const QByteArray &)
+	{
+		received++;
+		if (lookup) receivedInLookup++;
+	});
+
+	QVERIFY(writer.set(KEY, "one"));
+	reader.enableCache(1 << 20);
+	reader.subscribe(QString(CHANNEL));
+	QTRY_VERIFY(cached(reader, KEY, "one"));
+	QTRY_VERIFY(writer.publish(CHANNEL, "hi") > 0);
+
+	// the message arrives while no event loop runs, and the hit has to read
+	// past it to reach invalidations behind it
+	QVERIFY(writer.set(KEY, "two"));
+	QThread::msleep(100);
+	lookup = true;
+	QString value = reader.get(KEY);
+	lookup = false;
+	QCOMPARE(value, QString("two"));
+	QCOMPARE(receivedInLookup, 0);
+	QTRY_VERIFY(received > 0);
+}
+
+QTEST_GUILESS_MAIN(tst_rediscache)
+
+#include "tst_rediscache.moc"
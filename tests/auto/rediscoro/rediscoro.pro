@@ -0,0 +1,9 @@
+QT += network testlib
+QT -= gui
+CONFIG += testcase console c++2a
+CONFIG -= app_bundle
+TARGET = tst_rediscoro
+
+include(../../qredis.pri)
+
+SOURCES += tst_rediscoro.cpp
@@ -0,0 +1,57 @@
+#include <QtTest>
+#include "qrediscoro.h"
+
+#if defined(__cpp_impl_coroutine)
+
+/*
+ * Never run: it only has to compile, which instantiates QRedisCoro::run()
+ * with a descriptor of each decoder type and checks what it yields.
+ */
+static redis_task every_decoder(QRedisCoro redis)
+{
+	co_await redis.run(redis_commands::flushdb);
+	bool exists = co_await redis.run(redis_commands::exists, "key");
+	bool saving = co_await redis.run(redis_commands::bgsave);
+	bool pong = co_await redis.run(redis_commands::ping);
+	qlonglong counter = co_await redis.run(redis_commands::incr, "counter");
+	qreal real = co_await redis.run(redis_commands::incrbyfloat, "real", "1.5");
+	QString type = co_await redis.run(redis_commands::type, "key");
+	QByteArray value = co_await redis.run(redis_commands::get, "key");
+	QStringList keys = co_await redis.run(redis_commands::keys, "*");
+	QList<QByteArray> fields = co_await redis.run(redis_commands::hmget, "hash", QList<QByteArray>() << "a" << "b");
+	QStringList clients = co_await redis.run(redis_commands::client_list);
+	QDateTime time = co_await redis.run(redis_commands::time);
+	Q_UNUSED(exists);
+	Q_UNUSED(saving);
+	Q_UNUSED(pong);
+	Q_UNUSED(counter);
+	Q_UNUSED(real);
+	Q_UNUSED(type);
+	Q_UNUSED(value);
+	Q_UNUSED(keys);
+	Q_UNUSED(fields);
+	Q_UNUSED(clients);
+	Q_UNUSED(time);
+}
+
+#endif
+
+class tst_rediscoro : public QObject
+{
+	Q_OBJECT
+private slots:
+	void instantiate();
+};
+
+void tst_rediscoro::instantiate()
+{
+#if defined(__cpp_impl_coroutine)
+	redis_task (*coroutine)(QRedisCoro) = every_decoder;
+	QVERIFY(coroutine);
+#else
+	QSKIP("the compiler has no coroutine support");
+#endif
+}
+
+QTEST_MAIN(tst_rediscoro)
+#include "tst_rediscoro.moc"
@@ -0,0 +1,290 @@
+#include <QtTest>
+#include "qredis.h"
+
+/*
+ * Replies are rendered in a compact form to compare against: "+OK",
+ * "-ERR x", 42, "bulk", nil, ,1.5, #t, (123 and [a,b] for arrays, with
+ * % ~ > in front for maps, sets and pushes.
+ */
+static QByteArray render(const redis_reply &rr)
+{
+	switch (rr.type())
+	{
+	case REDIS_RESULT_NIL:
+		return "nil";
+	case REDIS_RESULT_ERROR:
+		return "-" + rr.error().toUtf8();
+	case REDIS_RESULT_STATUS:
+		return "+" + rr.status().toUtf8();
+	case REDIS_RESULT_INTEGER:
+		return QByteArray::number(rr.integer());
+	case REDIS_RESULT_STRING:
+		return "\"" + rr.bytes() + "\"";
+	case REDIS_RESULT_DOUBLE:
+		return "," + QByteArray::number(rr.real(), 'g', 17);
+	case REDIS_RESULT_BOOLEAN:
+		return rr.boolean() ? "#t" : "#f";
+	case REDIS_RESULT_BIGNUMBER:
+		return "(" + rr.bignumber().toUtf8();
+	default:
+		break;
+	}
+
+	QByteArray out;
+	if (rr.type() == REDIS_RESULT_MAP) out += '%';
+	if (rr.type() == REDIS_RESULT_SET) out += '~';
+	if (rr.type() == REDIS_RESULT_PUSH) out += '>';
+	out += '[';
+	for (int i = 0; i < rr.count(); i++)
+	{
+		if (i > 0) out += ',';
+		out += render(rr.at(i));
+	}
+	out += ']';
+	return out;
+}
+
+/*
+ * Feeds input in pieces of chunk bytes, taking replies as soon as they are
+ * complete, and renders them separated by spaces.
+ */
+static QByteArray parse_chunked(const QByteArray &input, int chunk, bool *error = 0)
+{
+	redis_parser parser;
+	QList<QByteArray> replies;
+	for (int i = 0; i < input.size(); i += chunk)
+	{
+		parser.feed(input.mid(i, chunk));
+		while (parser.hasReply())
+		{
+			replies.append(render(parser.takeReply()));
+		}
+	}
+
+	if (error) *error = parser.hasError();
+
+	QByteArray out;
+	for (int i = 0; i < replies.count(); i++)
+	{
+		if (i > 0) out += ' ';
+		out += replies.at(i);
+	}
+	return out;
+}
+
+class tst_redisparser : public QObject
+{
+	Q_OBJECT
+private slots:
+	void parse_data();
+	void parse();
+	void partialFrame();
+	void invalidInput();
+	void replyOutlivesParser();
+	void visitor();
+	void visitorSkipsNested_data();
+	void visitorSkipsNested();
+};
+
+void tst_redisparser::parse_data()
+{
+	QTest::addColumn<QByteArray>("input");
+	QTest::addColumn<QByteArray>("expected");
+
+	QTest::newRow("scalars")
+		<< QByteArray("+OK\r\n-ERR bad\r\n:42\r\n:-7\r\n$5\r\nhello\r\n$0\r\n\r\n")
+		<< QByteArray("+OK -ERR bad 42 -7 \"hello\" \"\"");
+	QTest::newRow("binary bulk")
+		<< QByteArray("$4\r\na\r\nb\r\n")
+		<< QByteArray("\"a\r\nb\"");
+	QTest::newRow("null bulk")
+		<< QByteArray("$-1\r\n")
+		<< QByteArray("nil");
+	QTest::newRow("null array")
+		<< QByteArray("*-1\r\n")
+		<< QByteArray("nil");
+	QTest::newRow("resp3 null")
+		<< QByteArray("_\r\n")
+		<< QByteArray("nil");
+	QTest::newRow("empty array")
+		<< QByteArray("*0\r\n")
+		<< QByteArray("[]");
+	QTest::newRow("nested")
+		<< QByteArray("*3\r\n:1\r\n*2\r\n$1\r\na\r\n*0\r\n$-1\r\n")
+		<< QByteArray("[1,[\"a\",[]],nil]");
+	QTest::newRow("nested nulls")
+		<< QByteArray("*2\r\n*-1\r\n*1\r\n$-1\r\n")
+		<< QByteArray("[nil,[nil]]");
+	QTest::newRow("deep")
+		<< QByteArray("*1\r\n*1\r\n*1\r\n*1\r\n:5\r\n")
+		<< QByteArray("[[[[5]]]]");
+	QTest::newRow("consecutive aggregates")
+		<< QByteArray("*2\r\n:1\r\n:2\r\n*1\r\n*1\r\n:3\r\n:4\r\n")
+		<< QByteArray("[1,2] [[3]] 4");
+	QTest::newRow("map")
+		<< QByteArray("%2\r\n+a\r\n:1\r\n+b\r\n*2\r\n:2\r\n:3\r\n")
+		<< QByteArray("%[+a,1,+b,[2,3]]");
+	QTest::newRow("resp3 scalars")
+		<< QByteArray("~4\r\n,1.5\r\n#t\r\n#f\r\n(12345678901234567890\r\n")
+		<< QByteArray("~[,1.5,#t,#f,(12345678901234567890]");
+	QTest::newRow("verbatim and blob error")
+		<< QByteArray("=8\r\ntxt:abcd\r\n!3\r\nbad\r\n")
+		<< QByteArray("\"abcd\" -bad");
+	QTest::newRow("attribute")
+		<< QByteArray("|1\r\n+ttl\r\n:3\r\n:9\r\n")
+		<< QByteArray("9");
+	QTest::newRow("nested attribute")
+		<< QByteArray("*2\r\n|1\r\n+a\r\n+b\r\n:1\r\n:2\r\n")
+		<< QByteArray("[1,2]");
+	QTest::newRow("push between replies")
+		<< QByteArray(":1\r\n>3\r\n+message\r\n+chan\r\n$2\r\nhi\r\n:2\r\n")
+		<< QByteArray("1 >[+message,+chan,\"hi\"] 2");
+	QTest::newRow("invalidate push before reply")
+		<< QByteArray(">2\r\n$10\r\ninvalidate\r\n*1\r\n$1\r\nk\r\n$1\r\nx\r\n>2\r\n$10\r\ninvalidate\r\n_\r\n")
+		<< QByteArray(">[\"invalidate\",[\"k\"]] \"x\" >[\"invalidate\",nil]");
+}
+
+void tst_redisparser::parse()
+{
+	QFETCH(QByteArray, input);
+	QFETCH(QByteArray, expected);
+
+	// every split point, down to one byte per read
+	for (int chunk = 1; chunk <= input.size(); chunk++)
+	{
+		bool error = true;
+		QCOMPARE(parse_chunked(input, chunk, &error), expected);
+		QVERIFY(!error);
+	}
+}
+
+void tst_redisparser::partialFrame()
+{
+	redis_parser parser;
+	parser.feed("*2\r\n$5\r\nhel");
+	QVERIFY(!parser.hasReply());
+	parser.feed("lo\r\n:");
+	QVERIFY(!parser.hasReply());
+	parser.feed("7\r");
+	QVERIFY(!parser.hasReply());
+	parser.feed("\n");
+	QVERIFY(parser.hasReply());
+	QCOMPARE(render(parser.takeReply()), QByteArray("[\"hello\",7]"));
+	QVERIFY(!parser.hasReply());
+}
+
+void tst_redisparser::invalidInput()
+{
+	bool error = false;
+	QCOMPARE(parse_chunked(":1\r\n?x\r\n:2\r\n", 3, &error), QByteArray("1"));
+	QVERIFY(error);
+
+	redis_parser parser;
+	parser.feed("?x\r\n");
+	QVERIFY(!parser.hasReply());
+	QVERIFY(parser.hasError());
+	parser.reset();
+	parser.feed(":1\r\n");
+	QVERIFY(!parser.hasError());
+	QVERIFY(parser.hasReply());
+	QCOMPARE(parser.takeReply().integer(), qlonglong(1));
+}
+
+void tst_redisparser::replyOutlivesParser()
+{
+	redis_reply rr;
+	{
+		redis_parser parser;
+		parser.feed("*2\r\n$3\r\nabc\r\n%1\r\n+k\r\n:1\r\n");
+		QVERIFY(parser.hasReply());
+		rr = parser.takeReply();
+	}
+	QCOMPARE(render(rr), QByteArray("[\"abc\",%[+k,1]]"));
+}
+
+void tst_redisparser::visitor()
+{
+	const QByteArray input("*3\r\n$1\r\na\r\n$-1\r\n:7\r\n*1\r\n$1\r\nz\r\n");
+	for (int chunk = 1; chunk <= input.size(); chunk++)
+	{
+		redis_parser parser;
+		QList<QByteArray> elements;
+		QList<redis_reply> replies;
+		redis_stream visitor([&elements](const QByteArray &element) { elements.append(element); });
+		for (int i = 0; i < input.size(); i += chunk)
+		{
+			// only the first reply is visited
+			parser.setStream(replies.isEmpty() ? visitor : redis_stream());
+			parser.feed(input.mid(i, chunk));
+			for (;;)
+			{
+				parser.setStream(replies.isEmpty() ? visitor : redis_stream());
+				if (!parser.hasReply()) break;
+				replies.append(parser.takeReply());
+			}
+		}
+
+		QCOMPARE(elements.count(), 3);
+		QCOMPARE(elements.at(0), QByteArray("a"));
+		QVERIFY(elements.at(1).isNull());
+		QCOMPARE(elements.at(2), QByteArray("7"));
+		QCOMPARE(replies.count(), 2);
+		QCOMPARE(render(replies.at(0)), QByteArray("3"));
+		QCOMPARE(render(replies.at(1)), QByteArray("[\"z\"]"));
+	}
+}
+
+void tst_redisparser::visitorSkipsNested_data()
+{
+	QTest::addColumn<QByteArray>("input");
+	QTest::addColumn<QByteArray>("elements");
+	QTest::addColumn<QByteArray>("expected");
+
+	QTest::newRow("attribute")
+		<< QByteArray("*2\r\n|1\r\n+ttl\r\n*1\r\n:5\r\n$1\r\nx\r\n$1\r\ny\r\n:9\r\n")
+		<< QByteArray("x y")
+		<< QByteArray("2 9");
+	QTest::newRow("nested element")
+		<< QByteArray("*4\r\n$1\r\na\r\n|1\r\n+ttl\r\n:5\r\n$1\r\nb\r\n*2\r\n:1\r\n*1\r\n$1\r\nz\r\n$1\r\nc\r\n:9\r\n")
+		<< QByteArray("a b c")
+		<< QByteArray("-nested element in a visited reply 9");
+	QTest::newRow("empty nested element")
+		<< QByteArray("*2\r\n%0\r\n$1\r\nc\r\n:9\r\n")
+		<< QByteArray("c")
+		<< QByteArray("-nested element in a visited reply 9");
+}
+
+void tst_redisparser::visitorSkipsNested()
+{
+	QFETCH(QByteArray, input);
+	QFETCH(QByteArray, elements);
+	QFETCH(QByteArray, expected);
+
+	for (int chunk = 1; chunk <= input.size(); chunk++)
+	{
+		redis_parser parser;
+		QList<QByteArray> visited;
+		QList<QByteArray> replies;
+		redis_stream visitor([&visited](const QByteArray &element) { visited.append(element); });
+		for (int i = 0; i < input.size(); i += chunk)
+		{
+			// only the first reply is visited; the one after it must still parse
+			parser.setStream(replies.isEmpty() ? visitor : redis_stream());
+			parser.feed(input.mid(i, chunk));
+			for (;;)
+			{
+				parser.setStream(replies.isEmpty() ? visitor : redis_stream());
+				if (!parser.hasReply()) break;
+				replies.append(render(parser.takeReply()));
+			}
+		}
+
+		QVERIFY(!parser.hasError());
+		QCOMPARE(visited.join(' '), elements);
+		QCOMPARE(replies.join(' '), expected);
+	}
+}
+
+QTEST_APPLESS_MAIN(tst_redisparser)
+
+#include "tst_redisparser.moc"
@@ -0,0 +1,9 @@
+QT += network testlib
+QT -= gui
+CONFIG += testcase console c++11
+CONFIG -= app_bundle
+TARGET = tst_redispool
+
+include(../../qredis.pri)
+
+SOURCES += tst_redispool.cpp
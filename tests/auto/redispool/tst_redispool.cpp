@@ -0,0 +1,153 @@
+#include <QtTest>
+#include <functional>
+#include "qredispool.h"
+#include "redistest.h"
+
+/*
+ * Connection pool against the server named by REDIS_TEST_HOST: leases,
+ * waiting for a free connection, handing one to another thread and
+ * closing idle or dead ones.
+ */
+
+static const char KEY[] = "qredis:test:pool";
+
+class redis_worker : public QThread
+{
+public:
+	explicit redis_worker(const std::function<void ()> &body) : m_body(body) {}
+protected:
+	void run() { m_body(); }
+private:
+	std::function<void ()> m_body;
+};
+
+class tst_redispool : public QObject
+{
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void lease();
+	void waitTimeout();
+	void crossThread();
+	void eviction();
+	void deadConnection();
+private:
+	QString m_host;
+	quint16 m_port;
+};
+
+void tst_redispool::initTestCase()
+{
+	if (!redis_test_host(m_host, m_port)) QSKIP("set REDIS_TEST_HOST=host[:port] to run");
+}
+
+void tst_redispool::lease()
+{
+	QRedisPool pool(m_host, m_port, 0, 2);
+	QCOMPARE(pool.size(), 0);
+
+	QRedis *redis = pool.acquire(1000);
+	QVERIFY(redis);
+	QVERIFY(redis->ping());
+	QCOMPARE(pool.size(), 1);
+	pool.release(redis);
+	QCOMPARE(pool.idleCount(), 1);
+
+	{
+		// the idle connection is handed out again rather than a new one
+		QRedisLease lease(&pool, 1000);
+		QVERIFY(lease.isValid());
+		QCOMPARE(lease.get(), redis);
+		QCOMPARE(pool.idleCount(), 0);
+	}
+	QCOMPARE(pool.idleCount(), 1);
+	QCOMPARE(pool.size(), 1);
+}
+
+void tst_redispool::waitTimeout()
+{
+	QRedisPool pool(m_host, m_port, 0, 1);
+	QRedisLease held(&pool, 1000);
+	QVERIFY(held.isValid());
+
+	QElapsedTimer timer;
+	timer.start();
+	QVERIFY(!pool.acquire(200));
+	QVERIFY(timer.elapsed() >= 200);
+	QVERIFY(timer.elapsed() < 2000);
+	QCOMPARE(pool.size(), 1);
+}
+
+void tst_redispool::crossThread()
+{
+	QRedisPool pool(m_host, m_port, 0, 1);
+	QRedis *redis = pool.acquire(1000);
+	QVERIFY(redis);
+
+	// the worker waits for the only connection and uses it on its thread
+	QRedis *taken = 0;
+	bool written = false;
+	redis_worker worker([&]()
+	{
+		taken = pool.acquire(5000);
+		if (!taken) return;
+		written = taken->set(KEY, "worker");
+		pool.release(taken);
+	});
+	worker.start();
+	QThread::msleep(100);
+	pool.release(redis);
+	QVERIFY(worker.wait(10000));
+	QCOMPARE(taken, redis);
+	QVERIFY(written);
+
+	// and back on this one
+	QRedisLease lease(&pool, 1000);
+	QCOMPARE(lease.get(), redis);
+	QCOMPARE(lease->get(KEY), QString("worker"));
+	QCOMPARE(lease->del(KEY), 1);
+}
+
+void tst_redispool::eviction()
+{
+	QRedisPool pool(m_host, m_port, 1, 3);
+	QCOMPARE(pool.size(), 1);
+	pool.setIdleTimeout(0);
+
+	QRedis *first = pool.acquire(1000);
+	QRedis *second = pool.acquire(1000);
+	QVERIFY(first && second);
+	pool.release(first);
+	pool.release(second);
+	QCOMPARE(pool.size(), 2);
+
+	// the maintenance timer closes idle connections down to the minimum
+	QTRY_COMPARE_WITH_TIMEOUT(pool.size(), 1, 5000);
+	QCOMPARE(pool.idleCount(), 1);
+}
+
+void tst_redispool::deadConnection()
+{
+	QRedisPool pool(m_host, m_port, 0, 1);
+	pool.setHealthCheckInterval(0);
+
+	QRedis *redis = pool.acquire(1000);
+	QVERIFY(redis);
+	qlonglong id = redis->command(QList<QByteArray>() << "client" << "id").integer();
+	pool.release(redis);
+
+	QRedis killer;
+	killer.connectHost(m_host, m_port);
+	redis_reply killed = killer.command(QList<QByteArray>() << "client" << "kill" << "id" << QByteArray::number(id));
+	QCOMPARE(killed.integer(), qlonglong(1));
+
+	// the check before the hand-out finds it closed and opens another
+	QRedisLease lease(&pool, 2000);
+	QVERIFY(lease.isValid());
+	QVERIFY(lease->ping());
+	QCOMPARE(pool.size(), 1);
+}
+
+QTEST_GUILESS_MAIN(tst_redispool)
+
+#include "tst_redispool.moc"
@@ -0,0 +1,110 @@
+#include <QtCore>
+#include <cstdio>
+#include "qredis.h"
+#include "redistest.h"
+
+/*
+ * The same workloads over each socket backend against the server named by
+ * REDIS_TEST_HOST: blocking round trips, pipelined asynchronous writes and
+ * reads of a large value.
+ */
+
+static const int ROUND_TRIPS = 20000;
+static const int PIPELINED = 200000;
+static const int LARGE_READS = 200;
+static const int LARGE_SIZE = 1024 * 1024;
+
+struct bench_backend
+{
+	const char *name;
+	QRedis::Backend backend;
+};
+
+static void run(const bench_backend &b, const QString &host, quint16 port)
+{
+	QRedis redis;
+	redis.setBackend(b.backend);
+	redis.setTimeout(30000);
+	redis.connectHost(host, port);
+	if (!redis.isConnected())
+	{
+		printf("%-8s not connected: %s\n", b.name, qPrintable(redis.lastError()));
+		return;
+	}
+
+	const QByteArray key("qredis:bench:transport");
+	const QByteArray value(16, 'v');
+	for (int i = 0; i < 1000; i++)
+	{
+		redis.ping();
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < ROUND_TRIPS; i++)
+	{
+		redis.ping();
+	}
+	double roundtrip = double(timer.nsecsElapsed()) / ROUND_TRIPS / 1000;
+
+	// a blocking call is answered after every command issued before it
+	int answered = 0;
+	timer.start();
+	for (int i = 0; i < PIPELINED; i++)
+	{
+		redis.setRaw(key, value, [&answered](bool) { answered++; });
+	}
+	redis.ping();
+	double pipelined = PIPELINED * 1e9 / timer.nsecsElapsed();
+	if (answered != PIPELINED)
+	{
+		printf("%-8s lost replies: %d of %d\n", b.name, answered, PIPELINED);
+		return;
+	}
+
+	redis.setRaw(key, QByteArray(LARGE_SIZE, 'x'));
+	qint64 bytes = 0;
+	timer.start();
+	for (int i = 0; i < LARGE_READS; i++)
+	{
+		bytes += redis.getRaw(key).size();
+	}
+	double large = bytes * 1e3 / timer.nsecsElapsed();
+	redis.del(QString::fromUtf8(key));
+
+	printf("%-8s %14.1f %14.0f %14.1f\n", b.name, roundtrip, pipelined, large);
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QString host;
+	quint16 port;
+	if (!redis_test_host(host, port))
+	{
+		printf("set REDIS_TEST_HOST=host[:port] to run\n");
+		return 0;
+	}
+
+	QList<bench_backend> backends;
+	bench_backend qt = { "qt", QRedis::QtBackend };
+	backends << qt;
+#ifdef Q_OS_LINUX
+	bench_backend epoll = { "epoll", QRedis::EpollBackend };
+	backends << epoll;
+#endif
+	if (QRedisUringTransport::isAvailable())
+	{
+		bench_backend uring = { "uring", QRedis::UringBackend };
+		backends << uring;
+	}
+
+	printf("%-8s %14s %14s %14s\n", "backend", "us/round trip", "pipelined/s", "1 MiB get MB/s");
+	foreach(const bench_backend &b, backends)
+	{
+		run(b, host, port);
+	}
+
+	return 0;
+}
@@ -0,0 +1,10 @@
+QT += network
+QT -= gui
+CONFIG += console c++11
+CONFIG -= app_bundle
+TARGET = bench_redistransport
+
+include(../../qredis.pri)
+
+HEADERS += ../../redistest.h
+SOURCES += main.cpp
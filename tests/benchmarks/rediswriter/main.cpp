@@ -0,0 +1,159 @@
+#include <QtCore>
+#include <cstdio>
+#include <cstdlib>
+#include "qredis.h"
+
+/*
+ * Encoding cost of the command writer against the QString based format()
+ * it replaced: time, encoded bytes per second and heap allocations per
+ * command. Allocations are counted by interposing malloc, which needs
+ * glibc; elsewhere they read as 0.
+ */
+
+#if defined(__GLIBC__)
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static qint64 allocations = 0;
+
+extern "C" void *malloc(size_t size)
+{
+	allocations++;
+	return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+	allocations++;
+	return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __libc_realloc(ptr, size);
+}
+#else
+static qint64 allocations = 0;
+#endif
+
+// QRedis::format() as it was before redis_writer
+static QByteArray format(const QList<QByteArray> &cmd)
+{
+	QByteArray result;
+	result.append(QString("*%1\r\n").arg(cmd.length()));
+
+	foreach(QByteArray part, cmd)
+	{
+		result.append("$");
+		result.append(QString::number(part.size()));
+		result.append("\r\n");
+		result.append(part);
+		result.append("\r\n");
+	}
+
+	return result;
+}
+
+struct bench_case
+{
+	const char *name;
+	QByteArray command;
+	QList<QByteArray> args;
+};
+
+struct bench_result
+{
+	double nsecs;
+	double bytes;
+	double allocations;
+};
+
+static const int COMMANDS = 200000;
+static const int FLUSH_BYTES = 16 * 1024;
+
+static bench_result run_format(const bench_case &c)
+{
+	qint64 bytes = 0;
+	qint64 before = allocations;
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < COMMANDS; i++)
+	{
+		// the command list was built per call, as the old methods did
+		QList<QByteArray> cmd;
+		cmd << c.command;
+		cmd += c.args;
+		bytes += format(cmd).size();
+	}
+	qint64 nsecs = timer.nsecsElapsed();
+	bench_result r = { double(nsecs) / COMMANDS, bytes * 1e9 / nsecs, double(allocations - before) / COMMANDS };
+	return r;
+}
+
+static bench_result run_writer(const bench_case &c)
+{
+	redis_writer writer;
+	qint64 bytes = 0;
+	qint64 before = allocations;
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < COMMANDS; i++)
+	{
+		writer.append({c.command.constData()}, c.args);
+		if (writer.size() >= FLUSH_BYTES)
+		{
+			// stands in for the write to the socket
+			bytes += writer.size();
+			writer.clear();
+		}
+	}
+	bytes += writer.size();
+	qint64 nsecs = timer.nsecsElapsed();
+	bench_result r = { double(nsecs) / COMMANDS, bytes * 1e9 / nsecs, double(allocations - before) / COMMANDS };
+	return r;
+}
+
+static bool same_encoding(const bench_case &c)
+{
+	QList<QByteArray> cmd;
+	cmd << c.command;
+	cmd += c.args;
+
+	redis_writer writer;
+	writer.append({c.command.constData()}, c.args);
+	return writer.toByteArray() == format(cmd);
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QList<bench_case> cases;
+	bench_case small = { "set 16 B", "set", QList<QByteArray>() << "key:000042" << QByteArray(16, 'v') };
+	bench_case large = { "set 1 KiB", "set", QList<QByteArray>() << "key:000042" << QByteArray(1024, 'v') };
+	bench_case wide = { "hmset 10 fields", "hmset", QList<QByteArray>() << "key:000042" };
+	for (int i = 0; i < 10; i++)
+	{
+		wide.args << "field:" + QByteArray::number(i) << QByteArray(16, 'v');
+	}
+	cases << small << large << wide;
+
+	printf("%-16s %-8s %10s %10s %12s\n", "command", "encoder", "ns/cmd", "MB/s", "allocs/cmd");
+	foreach(const bench_case &c, cases)
+	{
+		if (!same_encoding(c))
+		{
+			printf("%s: writer and format() disagree\n", c.name);
+			return 1;
+		}
+
+		bench_result before = run_format(c);
+		bench_result after = run_writer(c);
+		printf("%-16s %-8s %10.1f %10.1f %12.2f\n", c.name, "format", before.nsecs, before.bytes / 1e6, before.allocations);
+		printf("%-16s %-8s %10.1f %10.1f %12.2f\n", c.name, "writer", after.nsecs, after.bytes / 1e6, after.allocations);
+	}
+
+	return 0;
+}
@@ -0,0 +1,9 @@
+QT += network
+QT -= gui
+CONFIG += console c++11
+CONFIG -= app_bundle
+TARGET = bench_rediswriter
+
+include(../../qredis.pri)
+
+SOURCES += main.cpp
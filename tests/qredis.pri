@@ -0,0 +1,25 @@
+INCLUDEPATH += $$PWD/..
+DEPENDPATH += $$PWD/..
+
+HEADERS += $$PWD/../qredis.h \
+	$$PWD/../qrediscommands.h \
+	$$PWD/../qredispool.h \
+	$$PWD/../qredistransport.h
+
+SOURCES += $$PWD/../qredis.cpp \
+	$$PWD/../qredispool.cpp \
+	$$PWD/../qredistransport.cpp
+
+# QRedisCoro needs coroutines; a project opts in with CONFIG += c++2a
+c++2a|c++20 {
+	HEADERS += $$PWD/../qrediscoro.h
+	SOURCES += $$PWD/../qrediscoro.cpp
+}
+
+linux {
+	CONFIG += link_pkgconfig
+	packagesExist(liburing) {
+		DEFINES += QREDIS_HAVE_LIBURING
+		PKGCONFIG += liburing
+	}
+}
@@ -0,0 +1,21 @@
+#ifndef _REDISTEST_H_
+#define _REDISTEST_H_
+
+#include <QtCore>
+
+/*
+ * Address of the server that tests and benchmarks needing one run against,
+ * from REDIS_TEST_HOST as host[:port]. Without it they are skipped.
+ */
+static inline bool redis_test_host(QString &host, quint16 &port)
+{
+	QByteArray value = qgetenv("REDIS_TEST_HOST");
+	if (value.isEmpty()) return false;
+
+	int colon = value.lastIndexOf(':');
+	host = QString::fromUtf8(colon < 0 ? value : value.left(colon));
+	port = colon < 0 ? 6379 : value.mid(colon + 1).toUShort();
+	return true;
+}
+
+#endif //_REDISTEST_H_
@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+SUBDIRS = auto/redisparser \
+	auto/rediscache \
+	auto/redispool \
+	auto/rediscoro \
+	benchmarks/rediswriter \
+	benchmarks/redistransport